@@ -1,5 +1,15 @@
+#include <chrono>
+#include <cstdio>
 #include "MyGLCanvas.h"
 
+// how often the canvas looks at a background load (seconds)
+static const double LOAD_POLL = 1.0 / 15.0;
+
+// seconds on a monotonic clock, for frame timing
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 MyGLCanvas::MyGLCanvas(int x, int y, int w, int h, const char *l) : Fl_Gl_Window(x, y, w, h, l) {
 	mode(FL_RGB | FL_ALPHA | FL_DEPTH | FL_DOUBLE);
 	wireframe = 0;
@@ -7,17 +17,258 @@ MyGLCanvas::MyGLCanvas(int x, int y, int w, int h, const char *l) : Fl_Gl_Window
 	silhouette = 0;
 	showNormal = 0;
 	frontvBackFace = 0;
+	ambientOcclusion = 0;
+	silhouetteCached = 0;
+	featureEdges = 0;
+	featureAngle = 30;
+	showDeviation = 0;
+	showFrameTime = 0;
+	maxFPS = 60;
+	lastFrameStart = 0.0;
+	lastFrameTime = 0.0;
+	redrawScheduled = false;
+	pickedFace = -1;
+	loadStart = 0.0;
+	firstPixelReported = true;
 	rotX = rotY = rotZ = 0;
 	eyePosition = glm::vec3(0.0f, 0.0f, 2.0f);
 	red = green = blue = 0.5f;
 	myPLY = new ply();
+	myScene = new scene();
+	meshes = new meshCache(256 * 1024 * 1024);
+	tracker = new silhouetteTracker();
+	tracker->setMesh(myPLY);
+	viewCache = new silhouetteCache();
+	pendingCache = new silhouetteCache();
+	cacheRunning = false;
+	baker = new occlusionBaker();
+	occlusionRunning = false;
+	occlusionBaked = false;
+	reference = new ply();
+	comparer = new meshComparer();
 }
 
 MyGLCanvas::~MyGLCanvas() {
-	delete myPLY;
+	Fl::remove_timeout(loadTimeoutCB, this);
+	stopPrecompute();
+	if (!meshes->owns(myPLY)) {
+		delete myPLY;
+	}
+	delete meshes;
+	delete myScene;
+	delete tracker;
+	delete viewCache;
+	delete pendingCache;
+	delete baker;
+	delete reference;
+	delete comparer;
+}
+
+// the mesh cache belongs to the canvas, so the canvas reports it
+static void printCacheStats() {
+	meshCacheStats cacheStats = getMeshCacheStats();
+	printf("mesh cache hits:%ld misses:%ld evictions:%ld\n", cacheStats.hits, cacheStats.misses,
+		cacheStats.evictions);
+	printf("mesh cache resident (KB):%ld\n", (long)(cacheStats.residentBytes / 1024));
+}
+
+void MyGLCanvas::loadPLY(const char* filePath) {
+	// a bake for the old model is of no use, and it must not outlive it
+	stopPrecompute();
+	ply* previous = myPLY;
+	bool previousCached = meshes->owns(previous);
+
+	loadStart = now();
+	myPLY = meshes->acquire(filePath, true);
+	if (!previousCached) {
+		delete previous;
+	}
+	pickedFace = -1;
+	viewCache->clear();
+	deviationColors.clear();
+
+	Fl::remove_timeout(loadTimeoutCB, this);
+	if (myPLY->isLoading()) {
+		// the tracker is set up once the edges exist
+		firstPixelReported = false;
+		Fl::add_timeout(LOAD_POLL, loadTimeoutCB, this);
+	}
+	else {
+		tracker->setMesh(myPLY);
+		printCacheStats();
+		startPrecompute();
+	}
+}
+
+void MyGLCanvas::compareWith(const char* filePath) {
+	if (myPLY->isLoading()) {
+		printf("cannot compare while the model is still loading\n");
+		return;
+	}
+	deviationColors.clear();
+	if (!reference->reload(filePath)) {
+		return;
+	}
+
+	deviationStats both = comparer->compareBoth(myPLY, reference);
+	printf("deviation to %s: hausdorff %g, rms %g\n", filePath, comparer->forward.hausdorff, comparer->forward.rms);
+	printf("deviation from %s: hausdorff %g, rms %g\n", filePath, comparer->backward.hausdorff, comparer->backward.rms);
+	printf("symmetric: hausdorff %g, rms %g (%ld samples in %.3f s)\n", both.hausdorff, both.rms, both.samples,
+		comparer->lastSeconds);
+	// red is the largest deviation of this mesh's own vertices
+	meshComparer::colorMap(comparer->deviationA, (float)comparer->forward.hausdorff, deviationColors);
+}
+
+void MyGLCanvas::loadTimeoutCB(void* data) {
+	MyGLCanvas* canvas = (MyGLCanvas*)data;
+	canvas->requestRedraw();
+	if (canvas->myPLY->isLoading()) {
+		Fl::repeat_timeout(LOAD_POLL, loadTimeoutCB, data);
+		return;
+	}
+
+	// a failed load is left to the canvas, which deletes it with the
+	// next loadPLY
+	if (!canvas->meshes->refresh(canvas->myPLY)) {
+		printf("load failed after %.3f s\n", now() - canvas->loadStart);
+		return;
+	}
+	canvas->tracker->setMesh(canvas->myPLY);
+	printf("loaded in %.3f s\n", now() - canvas->loadStart);
+	canvas->myPLY->printAttributes();
+	printCacheStats();
+	canvas->startPrecompute();
+}
+
+void MyGLCanvas::startPrecompute() {
+	// a model still loading gets its jobs from loadTimeoutCB
+	if (myPLY->isLoading()) {
+		return;
+	}
+	if (ambientOcclusion && !myPLY->hasAmbientOcclusion() && !occlusionJob.joinable()) {
+		ply* mesh = myPLY;
+		occlusionRunning = true;
+		occlusionJob = thread([this, mesh]() {
+			occlusionBaked = baker->compute(mesh, bakedOcclusion);
+			occlusionRunning = false;
+		});
+	}
+	if (silhouetteCached && viewCache->getMesh() != myPLY && !cacheJob.joinable()) {
+		ply* mesh = myPLY;
+		cacheRunning = true;
+		cacheJob = thread([this, mesh]() {
+			pendingCache->build(mesh);
+			cacheRunning = false;
+		});
+	}
+	if (occlusionJob.joinable() || cacheJob.joinable()) {
+		Fl::remove_timeout(precomputeTimeoutCB, this);
+		Fl::add_timeout(LOAD_POLL, precomputeTimeoutCB, this);
+	}
+}
+
+void MyGLCanvas::stopPrecompute() {
+	Fl::remove_timeout(precomputeTimeoutCB, this);
+	baker->cancel = true;
+	pendingCache->cancel = true;
+	if (occlusionJob.joinable()) {
+		occlusionJob.join();
+	}
+	if (cacheJob.joinable()) {
+		cacheJob.join();
+	}
+	baker->cancel = false;
+	pendingCache->cancel = false;
+	vector<float>().swap(bakedOcclusion);
+	pendingCache->clear();
+}
+
+void MyGLCanvas::precomputeTimeoutCB(void* data) {
+	MyGLCanvas* canvas = (MyGLCanvas*)data;
+
+	// stopPrecompute joins any job for an older model, so a finished
+	// job here was for myPLY
+	if (canvas->occlusionJob.joinable() && !canvas->occlusionRunning) {
+		canvas->occlusionJob.join();
+		if (canvas->occlusionBaked) {
+			canvas->myPLY->setAmbientOcclusion(canvas->bakedOcclusion);
+			printf("ambient occlusion %s in %.3f s\n", canvas->baker->lastFromCache ? "read" : "baked",
+				canvas->baker->lastSeconds);
+			canvas->requestRedraw();
+		}
+		vector<float>().swap(canvas->bakedOcclusion);
+	}
+	if (canvas->cacheJob.joinable() && !canvas->cacheRunning) {
+		canvas->cacheJob.join();
+		swap(canvas->viewCache, canvas->pendingCache);
+		canvas->pendingCache->clear();
+		silhouetteCache* cache = canvas->viewCache;
+		printf("silhouette cache: %d samples, %.1f degree band, %.1f MB in %.3f s\n", cache->sampleCount,
+			cache->bandAngle, cache->getMemoryBytes() / (1024.0 * 1024.0), cache->buildSeconds);
+		canvas->requestRedraw();
+	}
+
+	if (canvas->occlusionJob.joinable() || canvas->cacheJob.joinable()) {
+		Fl::repeat_timeout(LOAD_POLL, precomputeTimeoutCB, data);
+	}
+}
+
+/*  ===============================================
+	  Desc: Unprojects the window position through the same projection
+	  as updateCamera and the same rotations as draw, giving a ray in
+	  the mesh's object space, and hands it to the mesh's BVH
+	=============================================== */
+bool MyGLCanvas::pick(int x, int y, rayHit& hit) {
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)w() / (float)h(), 0.1f, 10.0f)
+		* glm::lookAt(eyePosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 modelView = glm::rotate(glm::mat4(1.0), glm::radians((float)rotX), glm::vec3(1.0f, 0.0f, 0.0f));
+	modelView = glm::rotate(modelView, glm::radians((float)rotY), glm::vec3(0.0f, 1.0f, 0.0f));
+	modelView = glm::rotate(modelView, glm::radians((float)rotZ), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec4 viewport(0.0f, 0.0f, (float)w(), (float)h());
+
+	// window y runs down, GL's runs up; sample the pixel centre
+	glm::vec3 window((float)x + 0.5f, (float)(h() - y) - 0.5f, 0.0f);
+	glm::vec3 nearPoint = glm::unProject(window, modelView, projection, viewport);
+	window.z = 1.0f;
+	glm::vec3 farPoint = glm::unProject(window, modelView, projection, viewport);
+
+	if (!myPLY->pick(nearPoint, glm::normalize(farPoint - nearPoint), hit)) {
+		pickedFace = -1;
+		return false;
+	}
+	lastPick = hit;
+	pickedFace = hit.face;
+	return true;
+}
+
+/*  ===============================================
+	  Desc: Redraws now, or once the frame-rate cap allows it. Several
+	  requests before the next frame collapse into a single redraw.
+	=============================================== */
+void MyGLCanvas::requestRedraw() {
+	if (maxFPS <= 0) {
+		redraw();
+		return;
+	}
+
+	double wait = lastFrameStart + 1.0 / maxFPS - now();
+	if (wait <= 0.0) {
+		redraw();
+	}
+	else if (!redrawScheduled) {
+		redrawScheduled = true;
+		Fl::add_timeout(wait, redrawTimeoutCB, this);
+	}
+}
+
+void MyGLCanvas::redrawTimeoutCB(void* data) {
+	MyGLCanvas* canvas = (MyGLCanvas*)data;
+	canvas->redrawScheduled = false;
+	canvas->redraw();
 }
 
 void MyGLCanvas::draw() {
+	lastFrameStart = now();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	if (!valid()) {  //this is called when the GL canvas is set up for the first time...
@@ -78,7 +329,17 @@ void MyGLCanvas::draw() {
 
 	glm::vec3 curLookVector = glm::normalize(rotZMat * rotYMat * rotXMat * glm::vec4(-eyePosition, 0.0f));
 
-	myPLY->computeFrontFace(curLookVector);
+	// while the mesh is still being read only the progressive preview
+	// is drawn; normals, facing, silhouette and picking wait for the end
+	bool loading = myPLY->isLoading();
+
+	// only the front v. back face colouring needs every face's facing;
+	// the silhouette comes from the tracker
+	if (frontvBackFace && !loading) {
+		myPLY->computeFrontFace(curLookVector);
+	}
+	// the scene computes its own look vector per instance from the eye
+	glm::vec3 curEyePosition = glm::vec3(rotZMat * rotYMat * rotXMat * glm::vec4(eyePosition, 1.0f));
 
 	//allow for user controlled rotation
 	glRotatef(rotX, 1.0, 0.0, 0.0);
@@ -101,7 +362,24 @@ void MyGLCanvas::draw() {
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glColor3f(0.6, 0.6, 0.6);
 		glPolygonMode(GL_FRONT, GL_FILL);
-		myPLY->render(frontvBackFace);
+		if (loading) {
+			myPLY->renderProgress();
+		}
+		else if (showDeviation && (int)deviationColors.size() == myPLY->getVertexCount()) {
+			glShadeModel(GL_SMOOTH);
+			myPLY->renderColored(deviationColors);
+			glShadeModel(GL_FLAT);
+		}
+		else if (ambientOcclusion && myPLY->hasAmbientOcclusion()) {
+			// plain shading until the bake started by startPrecompute is in
+			glShadeModel(GL_SMOOTH);
+			myPLY->render(frontvBackFace, true);
+			glShadeModel(GL_FLAT);
+		}
+		else {
+			myPLY->render(frontvBackFace);
+		}
+		myScene->render(true);
 	}
 
 	if (wireframe) {
@@ -109,11 +387,17 @@ void MyGLCanvas::draw() {
 		glDisable(GL_POLYGON_OFFSET_FILL);
 		glColor3f(1.0, 1.0, 0.0);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		myPLY->render();
+		if (loading) {
+			myPLY->renderProgress();
+		}
+		else {
+			myPLY->render();
+		}
+		myScene->render(false);
 		glEnable(GL_LIGHTING);
 	}
 
-	if (showNormal) {
+	if (showNormal && !loading) {
 		glDisable(GL_LIGHTING);
 		glDisable(GL_POLYGON_OFFSET_FILL);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -125,17 +409,135 @@ void MyGLCanvas::draw() {
 		glDisable(GL_LIGHTING);
 		glColor3f(1.0, 1.0, 1.0);
 		glLineWidth(2);
-		myPLY->renderSilhouette(curLookVector);
+		if (!loading) {
+			// the tracker until the cache startPrecompute builds is in
+			if (silhouetteCached && viewCache->getMesh() == myPLY) {
+				myPLY->renderSilhouetteEdges(viewCache->update(curLookVector));
+			}
+			else {
+				myPLY->renderSilhouetteEdges(tracker->update(curLookVector));
+			}
+		}
+		myScene->renderSilhouette(curEyePosition);
 		glEnable(GL_LIGHTING);
 	}
+
+	// precomputed at load, so this is only a few display list calls
+	if (featureEdges && !loading) {
+		glDisable(GL_LIGHTING);
+		glColor3f(0.2f, 0.8f, 1.0f);
+		glLineWidth(2);
+		myPLY->renderFeatureEdges(featureAngle);
+		glEnable(GL_LIGHTING);
+	}
+
+	if (!loading && pickedFace >= 0 && pickedFace < myPLY->getFaceCount()) {
+		drawPick();
+	}
+
+	if (showFrameTime) {
+		drawFrameTime();
+		// glFinish so the time includes the GPU work, not just submission;
+		// only while the time is shown, as it stalls the pipeline
+		glFinish();
+		lastFrameTime = now() - lastFrameStart;
+	}
+	if (loading && !firstPixelReported && myPLY->getLoadedVertexCount() > 0) {
+		firstPixelReported = true;
+		printf("first points on screen after %.3f s\n", now() - loadStart);
+	}
 	//no need to call swap_buffer as it is automatically called
 }
 
+/*  ===============================================
+	  Desc: Draws the previous frame's time and the frame rate it allows
+	  in the top left corner, in window coordinates
+	=============================================== */
+void MyGLCanvas::drawFrameTime() {
+	char text[64];
+	if (lastFrameTime > 0.0) {
+		snprintf(text, sizeof(text), "%.2f ms (%.0f fps)", lastFrameTime * 1000.0, 1.0 / lastFrameTime);
+	}
+	else {
+		snprintf(text, sizeof(text), "-- ms");
+	}
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, w(), 0, h(), -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glColor3f(1.0f, 1.0f, 1.0f);
+	gl_font(FL_HELVETICA, 12);
+	gl_draw(text, 5.0f, (float)h() - 15.0f);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+}
+
+/*  ===============================================
+	  Desc: Outlines the picked face and marks its nearest vertex, on top
+	  of everything else
+	=============================================== */
+void MyGLCanvas::drawPick() {
+	face* f = myPLY->getFace(pickedFace);
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glColor3f(1.0f, 0.0f, 1.0f);
+	glLineWidth(2);
+	glBegin(GL_LINE_LOOP);
+	for (int j = 0; j < 3; j++) {
+		glm::vec3 position = myPLY->getVertex(f->vertexList[j])->position;
+		glVertex3f(position.x, position.y, position.z);
+	}
+	glEnd();
+
+	glm::vec3 nearest = myPLY->getVertex(lastPick.nearestVertex)->position;
+	glColor3f(1.0f, 1.0f, 0.0f);
+	glPointSize(8);
+	glBegin(GL_POINTS);
+	glVertex3f(nearest.x, nearest.y, nearest.z);
+	glEnd();
+	glPointSize(1);
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+}
+
 int MyGLCanvas::handle(int e) {
 	//printf("Event was %s (%d)\n", fl_eventnames[e], e);
 	switch (e) {
 	case FL_ENTER: cursor(FL_CURSOR_HAND); break;
 	case FL_LEAVE: cursor(FL_CURSOR_DEFAULT); break;
+	case FL_PUSH:
+		if (Fl::event_button() == FL_LEFT_MOUSE && !myPLY->isLoading()) {
+			rayHit hit;
+			double start = now();
+			bool found = pick(Fl::event_x(), Fl::event_y(), hit);
+			double elapsed = now() - start;
+			if (found) {
+				printf("picked face %d (u %.3f, v %.3f), nearest vertex %d at (%.4f, %.4f, %.4f) in %.1f us\n",
+					hit.face, hit.u, hit.v, hit.nearestVertex,
+					hit.position.x, hit.position.y, hit.position.z, elapsed * 1e6);
+			}
+			else {
+				printf("picked nothing in %.1f us\n", elapsed * 1e6);
+			}
+			requestRedraw();
+			return 1;
+		}
+		break;
 	}
 
 	return Fl_Gl_Window::handle(e);
@@ -3,6 +3,8 @@
 #ifndef MYGLCANVAS_H
 #define MYGLCANVAS_H
 
+#include <atomic>
+#include <thread>
 #include <FL/gl.h>
 #include <FL/glut.h>
 #include <FL/glu.h>
@@ -10,11 +12,29 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "ply.h"
+#include "scene.h"
+#include "meshcache.h"
+#include "silhouette.h"
+#include "occlusion.h"
+#include "meshcompare.h"
 
 
 class MyGLCanvas : public Fl_Gl_Window {
 public:
 	int wireframe, filled, silhouette, showNormal, frontvBackFace;
+	// modulates the filled mesh with baked per-vertex occlusion
+	int ambientOcclusion;
+	// takes the silhouette from silhouetteCache instead of the tracker
+	int silhouetteCached;
+	// draws the edges whose faces meet at featureAngle degrees or more
+	int featureEdges;
+	int featureAngle;
+	// colours myPLY by its distance to the mesh given to compareWith
+	int showDeviation;
+	// draws the last frame time in the corner of the canvas
+	int showFrameTime;
+	// redraws are spaced at least 1/maxFPS seconds apart (0 = no cap)
+	int maxFPS;
 	int rotX, rotY, rotZ;
 	float red, green, blue;
 	glm::vec3 eyePosition;
@@ -24,10 +44,96 @@ public:
 	/****************************************/
 	ply* myPLY = NULL;
 
+	/****************************************/
+	/*    Instanced meshes drawn with it    */
+	/****************************************/
+	scene* myScene = NULL;
+
 	MyGLCanvas(int x, int y, int w, int h, const char *l = 0);
 	~MyGLCanvas();
 
+	// Shows the model at filePath, reusing it from meshes if it was
+	// viewed recently. New files load in the background and are drawn
+	// progressively as they are read.
+	void loadPLY(const char* filePath);
+
+	// Loads filePath as the reference mesh and measures how far myPLY
+	// deviates from it, printing the distances; showDeviation draws
+	// them as colours
+	void compareWith(const char* filePath);
+
+	/****************************************/
+	/*  Call whenever something on screen   */
+	/*  changed. The canvas is only redrawn */
+	/*  on request, never continuously.     */
+	/****************************************/
+	void requestRedraw();
+
+	/****************************************/
+	/*  Starts what the toggles need that   */
+	/*  takes too long for a frame (the     */
+	/*  occlusion bake, the silhouette      */
+	/*  cache) on threads of their own;     */
+	/*  draw() does without them until they */
+	/*  are done. Call after changing       */
+	/*  ambientOcclusion or                 */
+	/*  silhouetteCached.                   */
+	/****************************************/
+	void startPrecompute();
+
+	/****************************************/
+	/*  Casts a ray from window pixel (x, y)*/
+	/*  through the current camera and      */
+	/*  rotation into myPLY. The hit is     */
+	/*  highlighted until the next pick.    */
+	/****************************************/
+	bool pick(int x, int y, rayHit& hit);
+
 private:
+	// recently viewed models; owns myPLY once a file has been loaded
+	meshCache* meshes;
+	// follows myPLY's silhouette from frame to frame
+	silhouetteTracker* tracker;
+	// built for myPLY when silhouetteCached is turned on; the tracker
+	// stands in until then
+	silhouetteCache* viewCache;
+	// the cache being built, swapped with viewCache when it is done
+	silhouetteCache* pendingCache;
+	thread cacheJob;
+	atomic<bool> cacheRunning;
+	// bakes myPLY's occlusion when ambientOcclusion is first turned on
+	occlusionBaker* baker;
+	// the bake running for myPLY, if any, and what it produced
+	thread occlusionJob;
+	atomic<bool> occlusionRunning;
+	vector<float> bakedOcclusion;
+	bool occlusionBaked;
+	// cancels and waits for both jobs, before myPLY changes
+	void stopPrecompute();
+	// collects finished jobs
+	static void precomputeTimeoutCB(void* data);
+	// the mesh of the last compareWith, and myPLY's colour per vertex
+	ply* reference;
+	meshComparer* comparer;
+	vector<glm::vec3> deviationColors;
+
+	static void redrawTimeoutCB(void* data);
+	// polls a background load, redrawing as it goes
+	static void loadTimeoutCB(void* data);
+	double loadStart;
+	bool firstPixelReported;
+	void drawFrameTime();
+	void drawPick();
+
+	// the last successful pick (pickedFace < 0 if none)
+	rayHit lastPick;
+	int pickedFace;
+
+	// when the last frame started and how long it took (seconds)
+	double lastFrameStart;
+	double lastFrameTime;
+	bool redrawScheduled;
+
 	void draw();
 	int handle(int);
 	void resize(int x, int y, int w, int h);
@@ -0,0 +1,666 @@
+/*  =================== File Information =================
+  File Name: bvh.cpp
+  Description: Builds and traverses the triangle BVH
+  ===================================================== */
+#include <cfloat>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "bvh.h"
+#include "parallel.h"
+#include "ply.h"
+
+using namespace std;
+
+static const int BIN_COUNT = 16;
+static const int MAX_LEAF_SIZE = 4;
+// subtrees with more triangles than this are built as separate tasks
+static const int PARALLEL_SUBTREE = 4096;
+// traversal stack entries kept on the frame; deeper trees use the heap
+static const int LOCAL_STACK = 128;
+
+bvh::bvh() {
+	nextNode = 0;
+	depth = 0;
+}
+
+void bvh::clear() {
+	vector<bvhNode>().swap(nodes);
+	vector<int>().swap(faceIndices);
+	vector<glm::vec3>().swap(corners);
+	vector<int>().swap(cornerVertices);
+	depth = 0;
+}
+
+size_t bvh::getMemoryBytes() {
+	return nodes.capacity() * sizeof(bvhNode)
+		+ faceIndices.capacity() * sizeof(int)
+		+ corners.capacity() * sizeof(glm::vec3)
+		+ cornerVertices.capacity() * sizeof(int);
+}
+
+size_t bvh::estimateMemoryBytes(int faceCount) {
+	// fewer nodes than faces in practice (leaves hold up to 4 triangles)
+	return (size_t)faceCount * (sizeof(bvhNode) + sizeof(int) + 3 * sizeof(glm::vec3) + 3 * sizeof(int));
+}
+
+static float surfaceArea(glm::vec3 low, glm::vec3 high) {
+	glm::vec3 size = high - low;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void bvh::build(ply* mesh) {
+	clear();
+	int faceCount = mesh->getFaceCount();
+	if (faceCount == 0) {
+		return;
+	}
+
+	building.resize(faceCount);
+	parallelFor(0, faceCount, 4096, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			face* f = mesh->getFace(i);
+			glm::vec3 a = mesh->getVertex(f->vertexList[0])->position;
+			glm::vec3 b = mesh->getVertex(f->vertexList[1])->position;
+			glm::vec3 c = mesh->getVertex(f->vertexList[2])->position;
+			building[i].face = i;
+			building[i].boxMin = glm::min(a, glm::min(b, c));
+			building[i].boxMax = glm::max(a, glm::max(b, c));
+			building[i].centroid = (building[i].boxMin + building[i].boxMax) * 0.5f;
+		}
+	});
+
+	// a binary tree with at least one triangle per leaf has < 2F nodes
+	nodes.resize(2 * (size_t)faceCount);
+	nextNode = 1;
+	depth = 0;
+	buildNode(0, 0, faceCount, 0);
+	nodes.resize(nextNode.load());
+	nodes.shrink_to_fit();
+
+	// copy the triangles into leaf order
+	faceIndices.resize(faceCount);
+	corners.resize(3 * (size_t)faceCount);
+	cornerVertices.resize(3 * (size_t)faceCount);
+	parallelFor(0, faceCount, 4096, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			faceIndices[i] = building[i].face;
+			face* f = mesh->getFace(faceIndices[i]);
+			for (int k = 0; k < 3; k++) {
+				cornerVertices[3 * (size_t)i + k] = f->vertexList[k];
+				corners[3 * (size_t)i + k] = mesh->getVertex(f->vertexList[k])->position;
+			}
+		}
+	});
+
+	vector<buildTriangle>().swap(building);
+}
+
+/*  ===============================================
+	  Desc: Fills in nodes[nodeIndex] for the triangles building[begin, end)
+	  The split is the cheapest of BIN_COUNT - 1 candidate planes per axis
+	  under the surface area heuristic; if no split beats a leaf, small
+	  ranges become leaves and large ones are split at the median.
+	=============================================== */
+void bvh::buildNode(int nodeIndex, int begin, int end, int level) {
+	bvhNode& node = nodes[nodeIndex];
+	int deepest = depth.load();
+	while (level > deepest && !depth.compare_exchange_weak(deepest, level)) {
+	}
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	glm::vec3 centerLow(FLT_MAX), centerHigh(-FLT_MAX);
+	for (int i = begin; i < end; i++) {
+		const buildTriangle& t = building[i];
+		low = glm::min(low, t.boxMin);
+		high = glm::max(high, t.boxMax);
+		centerLow = glm::min(centerLow, t.centroid);
+		centerHigh = glm::max(centerHigh, t.centroid);
+	}
+	node.boundsMin = low;
+	node.boundsMax = high;
+
+	int count = end - begin;
+	if (count <= MAX_LEAF_SIZE) {
+		node.first = begin;
+		node.count = count;
+		return;
+	}
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centerHigh[axis] - centerLow[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		int binCount[BIN_COUNT] = { 0 };
+		glm::vec3 binLow[BIN_COUNT], binHigh[BIN_COUNT];
+		for (int b = 0; b < BIN_COUNT; b++) {
+			binLow[b] = glm::vec3(FLT_MAX);
+			binHigh[b] = glm::vec3(-FLT_MAX);
+		}
+		float scale = BIN_COUNT / extent;
+		for (int i = begin; i < end; i++) {
+			const buildTriangle& t = building[i];
+			int b = min(BIN_COUNT - 1, (int)((t.centroid[axis] - centerLow[axis]) * scale));
+			binCount[b]++;
+			binLow[b] = glm::min(binLow[b], t.boxMin);
+			binHigh[b] = glm::max(binHigh[b], t.boxMax);
+		}
+
+		// sweep from the right to get the cost of everything right of each plane
+		float rightArea[BIN_COUNT];
+		int rightCount[BIN_COUNT];
+		glm::vec3 accLow(FLT_MAX), accHigh(-FLT_MAX);
+		int accCount = 0;
+		for (int b = BIN_COUNT - 1; b > 0; b--) {
+			accLow = glm::min(accLow, binLow[b]);
+			accHigh = glm::max(accHigh, binHigh[b]);
+			accCount += binCount[b];
+			rightArea[b] = accCount ? surfaceArea(accLow, accHigh) : 0.0f;
+			rightCount[b] = accCount;
+		}
+		accLow = glm::vec3(FLT_MAX);
+		accHigh = glm::vec3(-FLT_MAX);
+		accCount = 0;
+		for (int b = 0; b < BIN_COUNT - 1; b++) {
+			accLow = glm::min(accLow, binLow[b]);
+			accHigh = glm::max(accHigh, binHigh[b]);
+			accCount += binCount[b];
+			if (accCount == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			float cost = accCount * surfaceArea(accLow, accHigh) + rightCount[b + 1] * rightArea[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	int mid;
+	float leafCost = count * surfaceArea(low, high);
+	if (bestAxis >= 0 && (bestCost < leafCost || count > 4 * MAX_LEAF_SIZE)) {
+		float scale = BIN_COUNT / (centerHigh[bestAxis] - centerLow[bestAxis]);
+		float axisLow = centerLow[bestAxis];
+		int axis = bestAxis, bin = bestBin;
+		mid = (int)(partition(building.begin() + begin, building.begin() + end, [&](const buildTriangle& t) {
+			return min(BIN_COUNT - 1, (int)((t.centroid[axis] - axisLow) * scale)) <= bin;
+		}) - building.begin());
+	}
+	else if (count <= 4 * MAX_LEAF_SIZE) {
+		node.first = begin;
+		node.count = count;
+		return;
+	}
+	else {
+		// every centroid in the same place: any split is as good as another
+		mid = begin + count / 2;
+	}
+
+	int children = nextNode.fetch_add(2);
+	node.first = children;
+	node.count = 0;
+
+	if (count > PARALLEL_SUBTREE) {
+		taskGroup group;
+		group.run([=]() { buildNode(children, begin, mid, level + 1); });
+		buildNode(children + 1, mid, end, level + 1);
+		group.wait();
+	}
+	else {
+		buildNode(children, begin, mid, level + 1);
+		buildNode(children + 1, mid, end, level + 1);
+	}
+}
+
+int* bvh::traversalStack(int* local, vector<int>& heap) {
+	// each level down leaves at most one sibling behind, plus the two
+	// children of the deepest inner node
+	int size = depth.load() + 2;
+	if (size <= LOCAL_STACK) {
+		return local;
+	}
+	heap.resize(size);
+	return heap.data();
+}
+
+// distance along the ray to the box, or FLT_MAX if it misses within maxT
+static inline float hitBox(const bvhNode& node, glm::vec3 origin, glm::vec3 inverse, float maxT) {
+	glm::vec3 t0 = (node.boundsMin - origin) * inverse;
+	glm::vec3 t1 = (node.boundsMax - origin) * inverse;
+	glm::vec3 near = glm::min(t0, t1);
+	glm::vec3 far = glm::max(t0, t1);
+	float enter = max(max(near.x, near.y), max(near.z, 0.0f));
+	float exit = min(min(far.x, far.y), min(far.z, maxT));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+bool bvh::intersect(glm::vec3 origin, glm::vec3 direction, rayHit& hit) {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closest = FLT_MAX;
+	int hitSlot = -1;
+	float hitU = 0.0f, hitV = 0.0f;
+
+	int localStack[LOCAL_STACK];
+	vector<int> heapStack;
+	int* stack = traversalStack(localStack, heapStack);
+	int top = 0;
+	if (hitBox(nodes[0], origin, inverse, closest) == FLT_MAX) {
+		return false;
+	}
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const bvhNode& node = nodes[stack[--top]];
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				// Moller-Trumbore
+				glm::vec3 a = corners[3 * (size_t)i];
+				glm::vec3 edge1 = corners[3 * (size_t)i + 1] - a;
+				glm::vec3 edge2 = corners[3 * (size_t)i + 2] - a;
+				glm::vec3 p = glm::cross(direction, edge2);
+				float determinant = glm::dot(edge1, p);
+				if (fabs(determinant) < 1e-12f) {
+					continue;
+				}
+				float inverseDet = 1.0f / determinant;
+				glm::vec3 s = origin - a;
+				float u = glm::dot(s, p) * inverseDet;
+				if (u < 0.0f || u > 1.0f) {
+					continue;
+				}
+				glm::vec3 q = glm::cross(s, edge1);
+				float v = glm::dot(direction, q) * inverseDet;
+				if (v < 0.0f || u + v > 1.0f) {
+					continue;
+				}
+				float t = glm::dot(edge2, q) * inverseDet;
+				if (t > 0.0f && t < closest) {
+					closest = t;
+					hitSlot = i;
+					hitU = u;
+					hitV = v;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first by pushing it last
+		int left = node.first, right = node.first + 1;
+		float leftT = hitBox(nodes[left], origin, inverse, closest);
+		float rightT = hitBox(nodes[right], origin, inverse, closest);
+		if (leftT > rightT) {
+			swap(left, right);
+			swap(leftT, rightT);
+		}
+		if (rightT != FLT_MAX) {
+			stack[top++] = right;
+		}
+		if (leftT != FLT_MAX) {
+			stack[top++] = left;
+		}
+	}
+
+	if (hitSlot < 0) {
+		return false;
+	}
+	hit.face = faceIndices[hitSlot];
+	hit.t = closest;
+	hit.u = hitU;
+	hit.v = hitV;
+	hit.position = origin + direction * closest;
+	hit.nearestVertex = nearestCorner(hitSlot, hit.position);
+	return true;
+}
+
+int bvh::nearestCorner(int slot, glm::vec3 position) {
+	int nearest = 0;
+	float nearestDistance = FLT_MAX;
+	for (int k = 0; k < 3; k++) {
+		glm::vec3 offset = corners[3 * (size_t)slot + k] - position;
+		float distance = glm::dot(offset, offset);
+		if (distance < nearestDistance) {
+			nearestDistance = distance;
+			nearest = k;
+		}
+	}
+	return cornerVertices[3 * (size_t)slot + nearest];
+}
+
+// squared distance from point to the box, 0 inside it
+static inline float boxDistance(const bvhNode& node, glm::vec3 point) {
+	glm::vec3 outside = glm::max(glm::max(node.boundsMin - point, point - node.boundsMax), glm::vec3(0.0f));
+	return glm::dot(outside, outside);
+}
+
+/*  ===============================================
+	  Desc: The point of triangle abc closest to p, with its barycentric
+	  u (weight of b) and v (weight of c). Works out which vertex, edge
+	  or the inside region p projects to, after Ericson, Real-Time
+	  Collision Detection, 5.1.5. A degenerate triangle gives one of its
+	  edges or corners.
+	=============================================== */
+static glm::vec3 closestOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c, float& u, float& v) {
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+	glm::vec3 ap = p - a;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		u = 0.0f;
+		v = 0.0f;
+		return a;
+	}
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		u = 1.0f;
+		v = 0.0f;
+		return b;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float w = d1 - d3 > 0.0f ? d1 / (d1 - d3) : 0.0f;
+		u = w;
+		v = 0.0f;
+		return a + ab * w;
+	}
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		u = 0.0f;
+		v = 1.0f;
+		return c;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float w = d2 - d6 > 0.0f ? d2 / (d2 - d6) : 0.0f;
+		u = 0.0f;
+		v = w;
+		return a + ac * w;
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+		float sum = (d4 - d3) + (d5 - d6);
+		float w = sum > 0.0f ? (d4 - d3) / sum : 0.0f;
+		u = 1.0f - w;
+		v = w;
+		return b + (c - b) * w;
+	}
+
+	float sum = va + vb + vc;
+	if (!(sum > 0.0f)) {
+		u = 0.0f;
+		v = 0.0f;
+		return a;
+	}
+	u = vb / sum;
+	v = vc / sum;
+	return a + ab * u + ac * v;
+}
+
+bool bvh::closestPoint(glm::vec3 point, float maxDistance, rayHit& hit) {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	// squared distances from here on
+	float closest = maxDistance * maxDistance;
+	int hitSlot = -1;
+	float hitU = 0.0f, hitV = 0.0f;
+	glm::vec3 hitPosition(0.0f);
+
+	int localStack[LOCAL_STACK];
+	vector<int> heapStack;
+	int* stack = traversalStack(localStack, heapStack);
+	int top = 0;
+	if (boxDistance(nodes[0], point) > closest) {
+		return false;
+	}
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const bvhNode& node = nodes[stack[--top]];
+		// the box may have been pushed before something closer was found
+		if (boxDistance(node, point) > closest) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				float u, v;
+				glm::vec3 nearest = closestOnTriangle(point, corners[3 * (size_t)i], corners[3 * (size_t)i + 1],
+					corners[3 * (size_t)i + 2], u, v);
+				glm::vec3 offset = nearest - point;
+				float distance = glm::dot(offset, offset);
+				if (distance < closest || (hitSlot < 0 && distance <= closest)) {
+					closest = distance;
+					hitSlot = i;
+					hitU = u;
+					hitV = v;
+					hitPosition = nearest;
+				}
+			}
+			continue;
+		}
+
+		// visit the nearer child first by pushing it last
+		int left = node.first, right = node.first + 1;
+		float leftDistance = boxDistance(nodes[left], point);
+		float rightDistance = boxDistance(nodes[right], point);
+		if (leftDistance > rightDistance) {
+			swap(left, right);
+			swap(leftDistance, rightDistance);
+		}
+		if (rightDistance <= closest) {
+			stack[top++] = right;
+		}
+		if (leftDistance <= closest) {
+			stack[top++] = left;
+		}
+	}
+
+	if (hitSlot < 0) {
+		return false;
+	}
+	hit.face = faceIndices[hitSlot];
+	hit.t = sqrt(closest);
+	hit.u = hitU;
+	hit.v = hitV;
+	hit.position = hitPosition;
+	hit.nearestVertex = nearestCorner(hitSlot, hitPosition);
+	return true;
+}
+
+#if defined(__SSE2__)
+
+/*  ===============================================
+	  Desc: Packet traversal with SSE: every box and triangle test runs
+	  for the four rays at once, and a subtree is skipped as soon as no
+	  ray that is still unoccluded enters its box
+	=============================================== */
+int bvh::occluded(const rayPacket& packet, int active) {
+	if (nodes.empty() || active == 0) {
+		return 0;
+	}
+
+	__m128 originX = _mm_loadu_ps(packet.originX);
+	__m128 originY = _mm_loadu_ps(packet.originY);
+	__m128 originZ = _mm_loadu_ps(packet.originZ);
+	__m128 directionX = _mm_loadu_ps(packet.directionX);
+	__m128 directionY = _mm_loadu_ps(packet.directionY);
+	__m128 directionZ = _mm_loadu_ps(packet.directionZ);
+	__m128 minT = _mm_loadu_ps(packet.minT);
+	__m128 maxT = _mm_loadu_ps(packet.maxT);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 inverseX = _mm_div_ps(one, directionX);
+	__m128 inverseY = _mm_div_ps(one, directionY);
+	__m128 inverseZ = _mm_div_ps(one, directionZ);
+	__m128 epsilon = _mm_set1_ps(1e-12f);
+	__m128 signMask = _mm_set1_ps(-0.0f);
+
+	int hitMask = 0;
+	int localStack[LOCAL_STACK];
+	vector<int> heapStack;
+	int* stack = traversalStack(localStack, heapStack);
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const bvhNode& node = nodes[stack[--top]];
+		int live = active & ~hitMask;
+
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), originX), inverseX);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), originX), inverseX);
+		__m128 enter = _mm_max_ps(_mm_min_ps(t0, t1), minT);
+		__m128 exit = _mm_min_ps(_mm_max_ps(t0, t1), maxT);
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), originY), inverseY);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), originY), inverseY);
+		enter = _mm_max_ps(_mm_min_ps(t0, t1), enter);
+		exit = _mm_min_ps(_mm_max_ps(t0, t1), exit);
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), originZ), inverseZ);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), originZ), inverseZ);
+		enter = _mm_max_ps(_mm_min_ps(t0, t1), enter);
+		exit = _mm_min_ps(_mm_max_ps(t0, t1), exit);
+		if ((_mm_movemask_ps(_mm_cmple_ps(enter, exit)) & live) == 0) {
+			continue;
+		}
+
+		if (node.count == 0) {
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++) {
+			// Moller-Trumbore for four rays against one triangle
+			glm::vec3 a = corners[3 * (size_t)i];
+			glm::vec3 e1 = corners[3 * (size_t)i + 1] - a;
+			glm::vec3 e2 = corners[3 * (size_t)i + 2] - a;
+			__m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+			__m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+
+			__m128 px = _mm_sub_ps(_mm_mul_ps(directionY, e2z), _mm_mul_ps(directionZ, e2y));
+			__m128 py = _mm_sub_ps(_mm_mul_ps(directionZ, e2x), _mm_mul_ps(directionX, e2z));
+			__m128 pz = _mm_sub_ps(_mm_mul_ps(directionX, e2y), _mm_mul_ps(directionY, e2x));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+			__m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(signMask, determinant), epsilon);
+			__m128 inverseDet = _mm_div_ps(one, determinant);
+
+			__m128 sx = _mm_sub_ps(originX, _mm_set1_ps(a.x));
+			__m128 sy = _mm_sub_ps(originY, _mm_set1_ps(a.y));
+			__m128 sz = _mm_sub_ps(originZ, _mm_set1_ps(a.z));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+			__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+			__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+			__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qx), _mm_mul_ps(directionY, qy)), _mm_mul_ps(directionZ, qz)), inverseDet);
+			__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+			valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, minT));
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(t, maxT));
+			hitMask |= _mm_movemask_ps(valid) & live;
+			if ((active & ~hitMask) == 0) {
+				return hitMask;
+			}
+		}
+	}
+	return hitMask;
+}
+
+#else
+
+// the same traversal one ray lane at a time, for targets without SSE
+int bvh::occluded(const rayPacket& packet, int active) {
+	if (nodes.empty() || active == 0) {
+		return 0;
+	}
+
+	glm::vec3 origin[4], direction[4], inverse[4];
+	for (int k = 0; k < 4; k++) {
+		origin[k] = glm::vec3(packet.originX[k], packet.originY[k], packet.originZ[k]);
+		direction[k] = glm::vec3(packet.directionX[k], packet.directionY[k], packet.directionZ[k]);
+		inverse[k] = glm::vec3(1.0f / direction[k].x, 1.0f / direction[k].y, 1.0f / direction[k].z);
+	}
+
+	int hitMask = 0;
+	int localStack[LOCAL_STACK];
+	vector<int> heapStack;
+	int* stack = traversalStack(localStack, heapStack);
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const bvhNode& node = nodes[stack[--top]];
+		int live = 0;
+		for (int k = 0; k < 4; k++) {
+			if (((active & ~hitMask) >> k & 1) == 0) {
+				continue;
+			}
+			glm::vec3 t0 = (node.boundsMin - origin[k]) * inverse[k];
+			glm::vec3 t1 = (node.boundsMax - origin[k]) * inverse[k];
+			glm::vec3 near = glm::min(t0, t1);
+			glm::vec3 far = glm::max(t0, t1);
+			float enter = max(max(near.x, near.y), max(near.z, packet.minT[k]));
+			float exit = min(min(far.x, far.y), min(far.z, packet.maxT[k]));
+			if (enter <= exit) {
+				live |= 1 << k;
+			}
+		}
+		if (live == 0) {
+			continue;
+		}
+
+		if (node.count == 0) {
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++) {
+			glm::vec3 a = corners[3 * (size_t)i];
+			glm::vec3 edge1 = corners[3 * (size_t)i + 1] - a;
+			glm::vec3 edge2 = corners[3 * (size_t)i + 2] - a;
+			for (int k = 0; k < 4; k++) {
+				if ((live >> k & 1) == 0 || (hitMask >> k & 1)) {
+					continue;
+				}
+				glm::vec3 p = glm::cross(direction[k], edge2);
+				float determinant = glm::dot(edge1, p);
+				if (fabs(determinant) <= 1e-12f) {
+					continue;
+				}
+				float inverseDet = 1.0f / determinant;
+				glm::vec3 s = origin[k] - a;
+				float u = glm::dot(s, p) * inverseDet;
+				glm::vec3 q = glm::cross(s, edge1);
+				float v = glm::dot(direction[k], q) * inverseDet;
+				float t = glm::dot(edge2, q) * inverseDet;
+				if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > packet.minT[k] && t < packet.maxT[k]) {
+					hitMask |= 1 << k;
+				}
+			}
+			if ((active & ~hitMask) == 0) {
+				return hitMask;
+			}
+		}
+	}
+	return hitMask;
+}
+
+#endif
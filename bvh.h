@@ -0,0 +1,131 @@
+/*  =================== File Information =================
+        File Name: bvh.h
+        Description: Bounding volume hierarchy over the triangles of a mesh
+
+        Purpose:        Answer ray and closest-point queries (picking,
+                        occlusion, mesh comparison) without looking at
+                        every face
+        Examples:       See example below for using bvh class
+        ===================================================== */
+#ifndef BVH_H
+#define BVH_H
+
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+
+class ply;
+
+/*  ============== rayHit ==============
+        Purpose: The closest triangle a ray hit
+        position = (1 - u - v) * corner0 + u * corner1 + v * corner2
+        ==================================== */
+struct rayHit {
+        int face;
+        float t;
+        float u, v;
+        glm::vec3 position;
+        // the corner of face closest to position
+        int nearestVertex;
+};
+
+/*  ============== rayPacket ==============
+        Purpose: Four rays traced together (bvh::occluded), stored one
+        array per component so a box or triangle test handles all four
+        with one set of SIMD instructions. Ray i is only tested for
+        minT[i] < t < maxT[i].
+        ==================================== */
+struct rayPacket {
+        float originX[4], originY[4], originZ[4];
+        float directionX[4], directionY[4], directionZ[4];
+        float minT[4], maxT[4];
+};
+
+/*  ============== bvhNode ==============
+        Purpose: One box of the hierarchy. A leaf (count > 0) holds the
+        triangles first .. first + count - 1; an inner node (count == 0)
+        has its children at first and first + 1.
+        ==================================== */
+struct bvhNode {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int first;
+        int count;
+};
+
+/*  ============== bvh ==============
+        Purpose: Binary BVH built with the surface area heuristic (binned),
+        in parallel on the shared worker pool. The triangles are copied
+        into leaf order so a leaf's triangles sit next to each other.
+
+        Example usage:
+        1.) bvh* tree = new bvh();
+        2.) tree->build(myPLY);
+        3.) rayHit hit; if (tree->intersect(origin, direction, hit)) {...}
+        4.) delete tree;
+        ==================================== */
+class bvh {
+public:
+        bvh();
+
+        void build(ply* mesh);
+        void clear();
+
+        /*      ===============================================
+                Desc: Finds the closest triangle along origin + t * direction
+                (t > 0). Returns false if nothing is hit.
+        =============================================== */
+        bool intersect(glm::vec3 origin, glm::vec3 direction, rayHit& hit);
+        /*      ===============================================
+                Desc: Any-hit test for the rays of packet whose bit is set
+                in active. Returns the bits of the rays that hit a
+                triangle; stops as soon as every active ray has.
+        =============================================== */
+        int occluded(const rayPacket& packet, int active = 0xf);
+        /*      ===============================================
+                Desc: Finds the point on the mesh closest to point, if
+                one is within maxDistance. hit.t is its distance; face,
+                u, v, position and nearestVertex are as for intersect.
+                Returns false if nothing is that close.
+        =============================================== */
+        bool closestPoint(glm::vec3 point, float maxDistance, rayHit& hit);
+
+        int getNodeCount() { return (int)nodes.size(); }
+        size_t getMemoryBytes();
+        // roughly what build() will use for a mesh of faceCount faces
+        static size_t estimateMemoryBytes(int faceCount);
+
+private:
+        void buildNode(int nodeIndex, int begin, int end, int level);
+        // stack for a traversal: local when the tree is shallow enough,
+        // otherwise heap, which is resized to fit
+        int* traversalStack(int* local, vector<int>& heap);
+        // the mesh vertex of triangle slot's corner closest to position
+        int nearestCorner(int slot, glm::vec3 position);
+
+        vector<bvhNode> nodes;
+        // mesh face of each triangle slot, in leaf order
+        vector<int> faceIndices;
+        // corner positions of each triangle slot, 3 per triangle
+        vector<glm::vec3> corners;
+        // mesh vertex of each corner, 3 per triangle
+        vector<int> cornerVertices;
+
+        // used while building only: the bounds of each triangle, kept in
+        // the same order as the triangles so partitioning moves them along
+        struct buildTriangle {
+                glm::vec3 boxMin;
+                glm::vec3 boxMax;
+                glm::vec3 centroid;
+                int face;
+        };
+        vector<buildTriangle> building;
+        atomic<int> nextNode;
+        // deepest leaf level; a traversal never holds more than
+        // depth + 1 nodes on its stack
+        atomic<int> depth;
+};
+
+#endif
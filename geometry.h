@@ -1,6 +1,8 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
+#include <vector>
+
 /*  ============== Vertex ==============
 	Purpose: Stores properties of each vertex
 	Use: Used in face structure
@@ -60,4 +62,18 @@ public:
             return true;
         }
 };
+
+/* Polyline: Silhouette edges linked through their shared vertices.
+ * vertices are indices into the vertex list, in drawing order. A closed
+ * polyline (loop) does not repeat its first vertex at the end.
+ */
+class polyline{
+public:
+        std::vector<int> vertices;
+        bool closed;
+
+        polyline(){
+            closed = false;
+        }
+};
 #endif
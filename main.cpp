@@ -46,16 +46,27 @@ public:
     Fl_Button  *normalButton;
     Fl_Button  *debugFaceButton;
     Fl_Button  *silhouetteButton;
+    Fl_Button  *silhouetteCacheButton;
+    Fl_Button  *featureButton;
+    Fl_Slider  *featureAngleSlider;
+    Fl_Button  *occlusionButton;
+    Fl_Button  *frameTimeButton;
+    Fl_Slider  *maxFPSSlider;
     Fl_Button  *openFileButton;
+    Fl_Button  *instanceButton;
+    Fl_Button  *clearSceneButton;
+    Fl_Button  *compareButton;
+    Fl_Button  *deviationButton;
     MyGLCanvas *canvas;
 
 public:
     // APP WINDOW CONSTRUCTOR
     MyAppWindow(int W, int H, const char *L = 0);
 
-    static void idleCB(void *data) {
-        MyAppWindow *win = (MyAppWindow *)data;
-        win->canvas->redraw();
+    // The canvas is only redrawn when something changes, so every
+    // callback that changes what is on screen ends with this
+    static void changedCB(Fl_Widget *w) {
+        ((MyAppWindow *)w->top_window())->canvas->requestRedraw();
     }
 
 private:
@@ -63,15 +74,26 @@ private:
     static void rotateCB(Fl_Widget *w, void *userdata) {
         int value          = ((Fl_Slider *)w)->value();
         *((int *)userdata) = value;
+        changedCB(w);
     }
 
     static void buttonIntCB(Fl_Widget *w, void *userdata) {
         int value          = ((Fl_Button *)w)->value();
         *((int *)userdata) = value;
+        changedCB(w);
     }
 
-    static void loadFileCB(Fl_Widget *w, void *data) {
-        MyAppWindow    *win = (MyAppWindow *)data;
+    // A toggle whose data is computed in the background when it is
+    // turned on (see MyGLCanvas::startPrecompute)
+    static void precomputeIntCB(Fl_Widget *w, void *userdata) {
+        buttonIntCB(w, userdata);
+        ((MyAppWindow *)w->top_window())->canvas->startPrecompute();
+    }
+
+    // Opens the file chooser and blocks until the user picks a file.
+    // Returns NULL if the user cancelled.
+    static const char *chooseFile() {
+        static string   chosen;
         Fl_File_Chooser G_chooser("", "", Fl_File_Chooser::MULTI, "");
         G_chooser.show();
         // Block until user picks something.
@@ -85,16 +107,65 @@ private:
         // Print the results
         if (G_chooser.value() == NULL) {
             printf("User cancelled file chooser\n");
+            return NULL;
+        }
+        chosen = G_chooser.value();
+        return chosen.c_str();
+    }
+
+    static void loadFileCB(Fl_Widget *w, void *data) {
+        MyAppWindow *win  = (MyAppWindow *)data;
+        const char  *file = chooseFile();
+        if (file == NULL) {
             return;
         }
 
-        cout << "Loading new ply file from: " << G_chooser.value() << endl;
-        // Reload our model
-        win->canvas->myPLY->reload(G_chooser.value());
-        // Print out the attributes
-        win->canvas->myPLY->printAttributes();
+        cout << "Loading new ply file from: " << file << endl;
+        // Reload our model (or swap back to it if it was viewed recently)
+        win->canvas->loadPLY(file);
+        // Print out the attributes (the canvas prints them for new files
+        // once they have finished loading)
+        if (!win->canvas->myPLY->isLoading()) {
+            win->canvas->myPLY->printAttributes();
+        }
 
-        win->canvas->redraw();
+        win->canvas->requestRedraw();
+    }
+
+    // Adds a grid of instances of a model to the canvas' scene
+    static void addInstancesCB(Fl_Widget *w, void *data) {
+        MyAppWindow *win  = (MyAppWindow *)data;
+        const char  *file = chooseFile();
+        if (file == NULL) {
+            return;
+        }
+
+        cout << "Adding instances of: " << file << endl;
+        int mesh = win->canvas->myScene->addMesh(file);
+        win->canvas->myScene->addGrid(mesh, 10, 10);
+        cout << "scene instances:" << win->canvas->myScene->getInstanceCount() << endl;
+
+        win->canvas->requestRedraw();
+    }
+
+    // Measures the model's deviation from another file (e.g. its
+    // simplified version)
+    static void compareCB(Fl_Widget *w, void *data) {
+        MyAppWindow *win  = (MyAppWindow *)data;
+        const char  *file = chooseFile();
+        if (file == NULL) {
+            return;
+        }
+
+        cout << "Comparing with: " << file << endl;
+        win->canvas->compareWith(file);
+        win->canvas->requestRedraw();
+    }
+
+    static void clearSceneCB(Fl_Widget *w, void *data) {
+        MyAppWindow *win = (MyAppWindow *)data;
+        win->canvas->myScene->clear();
+        win->canvas->requestRedraw();
     }
 };
 
@@ -123,6 +194,15 @@ MyAppWindow::MyAppWindow(int W, int H, const char *L) : Fl_Window(W, H, L) {
     openFileButton = new Fl_Button(0, 100, pack->w() - 20, 20, "Load File");
     openFileButton->callback(loadFileCB, (void *)this);
 
+    instanceButton = new Fl_Button(0, 100, pack->w() - 20, 20, "Add Instances");
+    instanceButton->callback(addInstancesCB, (void *)this);
+
+    clearSceneButton = new Fl_Button(0, 100, pack->w() - 20, 20, "Clear Scene");
+    clearSceneButton->callback(clearSceneCB, (void *)this);
+
+    compareButton = new Fl_Button(0, 100, pack->w() - 20, 20, "Compare With");
+    compareButton->callback(compareCB, (void *)this);
+
     wireButton = new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Wireframe");
     wireButton->callback(buttonIntCB, (void *)(&canvas->wireframe));
     wireButton->value(canvas->wireframe);
@@ -146,6 +226,54 @@ MyAppWindow::MyAppWindow(int W, int H, const char *L) : Fl_Window(W, H, L) {
     silhouetteButton->callback(buttonIntCB, (void *)(&canvas->silhouette));
     silhouetteButton->value(canvas->silhouette);
 
+    // precomputed per view direction the first time it is drawn
+    silhouetteCacheButton =
+        new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Silhouette Cache");
+    silhouetteCacheButton->callback(precomputeIntCB, (void *)(&canvas->silhouetteCached));
+    silhouetteCacheButton->value(canvas->silhouetteCached);
+
+    // blue on the reference surface, red at the largest distance
+    deviationButton =
+        new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Deviation");
+    deviationButton->callback(buttonIntCB, (void *)(&canvas->showDeviation));
+    deviationButton->value(canvas->showDeviation);
+
+    featureButton =
+        new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Feature Edges");
+    featureButton->callback(buttonIntCB, (void *)(&canvas->featureEdges));
+    featureButton->value(canvas->featureEdges);
+
+    // minimum angle between the faces of a feature edge, in degrees
+    Fl_Box *featureAngleTextbox = new Fl_Box(0, 0, pack->w() - 20, 20, "Feature Angle");
+    featureAngleSlider          = new Fl_Value_Slider(0, 0, pack->w() - 20, 20, "");
+    featureAngleSlider->align(FL_ALIGN_TOP);
+    featureAngleSlider->type(FL_HOR_SLIDER);
+    featureAngleSlider->bounds(1, 179);
+    featureAngleSlider->step(1);
+    featureAngleSlider->value(canvas->featureAngle);
+    featureAngleSlider->callback(rotateCB, (void *)(&(canvas->featureAngle)));
+
+    // baked (or read from <model>.ao) the first time it is drawn
+    occlusionButton =
+        new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Ambient Occlusion");
+    occlusionButton->callback(precomputeIntCB, (void *)(&canvas->ambientOcclusion));
+    occlusionButton->value(canvas->ambientOcclusion);
+
+    frameTimeButton =
+        new Fl_Check_Button(0, 100, pack->w() - 20, 20, "Frame Time");
+    frameTimeButton->callback(buttonIntCB, (void *)(&canvas->showFrameTime));
+    frameTimeButton->value(canvas->showFrameTime);
+
+    // 0 turns the cap off
+    Fl_Box *maxFPSTextbox = new Fl_Box(0, 0, pack->w() - 20, 20, "Max FPS");
+    maxFPSSlider          = new Fl_Value_Slider(0, 0, pack->w() - 20, 20, "");
+    maxFPSSlider->align(FL_ALIGN_TOP);
+    maxFPSSlider->type(FL_HOR_SLIDER);
+    maxFPSSlider->bounds(0, 240);
+    maxFPSSlider->step(1);
+    maxFPSSlider->value(canvas->maxFPS);
+    maxFPSSlider->callback(rotateCB, (void *)(&(canvas->maxFPS)));
+
 
     // slider for controlling rotation
     Fl_Box *rotXTextbox = new Fl_Box(0, 0, pack->w() - 20, 20, "RotateX");
@@ -216,13 +344,13 @@ MyAppWindow::MyAppWindow(int W, int H, const char *L) : Fl_Window(W, H, L) {
     end();
 
     resizable(this);
-    Fl::add_idle((Fl_Idle_Handler)(void *)idleCB, (void *)this);
 }
 
 
 /**************************************** main() ********************/
 int main(int argc, char **argv) {
-    MyAppWindow win(600, 500, "User Interface");
+    // tall enough for the control panel: 24 rows of 20 from y = 30
+    MyAppWindow win(600, 540, "User Interface");
     win.show();
     return (Fl::run());
 }
\ No newline at end of file
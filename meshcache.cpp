@@ -0,0 +1,176 @@
+/*  =================== File Information =================
+  File Name: meshcache.cpp
+  Description: LRU cache of loaded ply meshes
+  ===================================================== */
+#include <iostream>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "meshcache.h"
+
+using namespace std;
+
+static meshCacheStats globalStats = { 0, 0, 0, 0 };
+
+meshCacheStats getMeshCacheStats() {
+	return globalStats;
+}
+
+/*  ===============================================
+	  Desc: Resolves a path to the absolute path without symlinks or
+	  ./.. parts, so that two spellings of the same file share one entry
+	=============================================== */
+static string canonicalPath(string filePath) {
+	char resolved[PATH_MAX];
+	if (realpath(filePath.c_str(), resolved) == NULL) {
+		return filePath;
+	}
+	return string(resolved);
+}
+
+meshCache::meshCache(size_t _byteBudget) {
+	byteBudget = _byteBudget;
+	residentBytes = 0;
+}
+
+meshCache::~meshCache() {
+	clear();
+}
+
+void meshCache::clear() {
+	while (!entries.empty()) {
+		erase(--entries.end());
+	}
+}
+
+void meshCache::erase(list<cacheEntry>::iterator it) {
+	residentBytes -= it->bytes;
+	globalStats.residentBytes -= it->bytes;
+	index.erase(it->path);
+	delete it->mesh;
+	entries.erase(it);
+}
+
+void meshCache::setBudget(size_t _byteBudget) {
+	byteBudget = _byteBudget;
+	evict();
+}
+
+void meshCache::count(list<cacheEntry>::iterator it) {
+	size_t bytes = it->mesh->getMemoryBytes();
+	residentBytes += bytes - it->bytes;
+	globalStats.residentBytes += bytes - it->bytes;
+	it->bytes = bytes;
+	it->loading = false;
+}
+
+void meshCache::recount() {
+	list<cacheEntry>::iterator it = entries.begin();
+	while (it != entries.end()) {
+		list<cacheEntry>::iterator next = it;
+		++next;
+		if (it->loading && !it->mesh->isLoading()) {
+			if (it->mesh->finishLoad()) {
+				count(it);
+			}
+			else {
+				erase(it);
+			}
+		}
+		it = next;
+	}
+}
+
+/*  ===============================================
+	  Desc: Drops least recently used meshes until the cache fits in the
+	  budget again. The front (most recent) entry always stays.
+	=============================================== */
+void meshCache::evict() {
+	recount();
+	while (residentBytes > byteBudget && entries.size() > 1) {
+		erase(--entries.end());
+		globalStats.evictions++;
+	}
+}
+
+bool meshCache::refresh(ply* mesh) {
+	bool loaded = mesh->finishLoad();
+	for (list<cacheEntry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+		if (it->mesh == mesh) {
+			if (loaded) {
+				count(it);
+			}
+			else {
+				// handed to the caller, who still holds it
+				residentBytes -= it->bytes;
+				globalStats.residentBytes -= it->bytes;
+				index.erase(it->path);
+				entries.erase(it);
+			}
+			break;
+		}
+	}
+	evict();
+	return loaded;
+}
+
+bool meshCache::owns(ply* mesh) {
+	for (list<cacheEntry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+		if (it->mesh == mesh) {
+			return true;
+		}
+	}
+	return false;
+}
+
+ply* meshCache::acquire(string filePath, bool progressive) {
+	string path = canonicalPath(filePath);
+	struct stat info;
+	time_t mtime = 0;
+	if (stat(path.c_str(), &info) == 0) {
+		mtime = info.st_mtime;
+	}
+
+	// finished progressive loads are counted, and failed ones dropped,
+	// before they can be handed out again
+	recount();
+	map<string, list<cacheEntry>::iterator>::iterator found = index.find(path);
+	if (found != index.end()) {
+		if (found->second->mtime == mtime) {
+			// hit: move to the front and hand out the same mesh
+			entries.splice(entries.begin(), entries, found->second);
+			globalStats.hits++;
+			return entries.front().mesh;
+		}
+		// the file changed on disk since we cached it
+		erase(found->second);
+	}
+
+	globalStats.misses++;
+	cacheEntry entry;
+	entry.path = path;
+	entry.mtime = mtime;
+	entry.mesh = new ply();
+	if (progressive) {
+		// counted by recount() or refresh() once the load is done
+		entry.mesh->beginLoad(filePath);
+		entry.bytes = 0;
+		entry.loading = true;
+	}
+	else {
+		if (!entry.mesh->reload(filePath)) {
+			delete entry.mesh;
+			return NULL;
+		}
+		entry.bytes = entry.mesh->getMemoryBytes();
+		entry.loading = false;
+	}
+
+	entries.push_front(entry);
+	index[path] = entries.begin();
+	residentBytes += entry.bytes;
+	globalStats.residentBytes += entry.bytes;
+	evict();
+
+	return entries.front().mesh;
+}
@@ -0,0 +1,101 @@
+/*  =================== File Information =================
+        File Name: meshcache.h
+        Description: In-memory LRU cache of fully processed meshes
+
+        Purpose:        Switch back to a recently viewed model without
+                        parsing it and rebuilding its edges again
+        Examples:       See example below for using meshCache class
+        ===================================================== */
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <ctime>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== meshCacheStats ==============
+        Purpose: Counters shared by every meshCache in the process
+        (printed by MyGLCanvas after each load)
+        ==================================== */
+struct meshCacheStats {
+        long hits;
+        long misses;
+        long evictions;
+        size_t residentBytes;
+};
+meshCacheStats getMeshCacheStats();
+
+/*  ============== meshCache ==============
+        Purpose: Keeps loaded ply objects around, keyed by canonical path
+        and modification time, and drops the least recently used ones once
+        the bytes they hold go over the budget.
+
+        The cache owns every mesh it returns. The mesh returned by the most
+        recent acquire() is never evicted, so it is safe to keep drawing it
+        until the next acquire().
+
+        Example usage:
+        1.) meshCache* cache = new meshCache(256 * 1024 * 1024);
+        2.) ply* myPLY = cache->acquire("./data/cow.ply");
+        3.) myPLY->render();
+        4.) delete cache;   // deletes every cached mesh
+        ==================================== */
+class meshCache {
+public:
+        meshCache(size_t _byteBudget);
+        ~meshCache();
+
+        /*      ===============================================
+                Desc: Returns the mesh for filePath, loading it on a miss
+                or when the file changed on disk since it was cached.
+                Returns NULL if the file cannot be loaded; nothing is
+                cached for it then.
+                With progressive set a miss returns at once with the
+                mesh still loading (see ply::beginLoad). Its bytes are
+                counted by the first acquire() or refresh() after the
+                load is done; a load that failed is dropped then.
+        =============================================== */
+        ply* acquire(string filePath, bool progressive = false);
+        /*      ===============================================
+                Desc: Waits for mesh to finish loading and counts its
+                bytes. Returns false if the load failed: the entry is
+                dropped and the caller now owns (and deletes) mesh.
+        =============================================== */
+        bool refresh(ply* mesh);
+        bool owns(ply* mesh);
+        void clear();
+
+        void setBudget(size_t _byteBudget);
+        size_t getBudget() { return byteBudget; }
+        size_t getResidentBytes() { return residentBytes; }
+        int getEntryCount() { return (int)entries.size(); }
+
+private:
+        struct cacheEntry {
+                string path;
+                time_t mtime;
+                size_t bytes;
+                ply* mesh;
+                // a progressive load whose bytes are not counted yet
+                bool loading;
+        };
+
+        void evict();
+        // counts the entries whose progressive load has finished and
+        // drops the ones that failed
+        void recount();
+        void count(list<cacheEntry>::iterator it);
+        void erase(list<cacheEntry>::iterator it);
+
+        // most recently used entry first
+        list<cacheEntry> entries;
+        map<string, list<cacheEntry>::iterator> index;
+        size_t byteBudget;
+        size_t residentBytes;
+};
+
+#endif
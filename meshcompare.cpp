@@ -0,0 +1,127 @@
+/*  =================== File Information =================
+  File Name: meshcompare.cpp
+  Description: Closest-point sampling of one mesh against another
+  ===================================================== */
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include "meshcompare.h"
+#include "parallel.h"
+
+using namespace std;
+
+meshComparer::meshComparer() {
+	sampleFaces = true;
+	lastSeconds = 0.0;
+}
+
+/*  ===============================================
+	  Desc: Samples 0 .. vertexCount - 1 are the vertices of from, the
+	  rest the centroids of its faces.
+	  Neighbouring samples are close together, so the distance from a
+	  sample to the point found for the one before it bounds the
+	  search; the BVH then skips every box further away than that.
+	=============================================== */
+deviationStats meshComparer::compare(ply* from, ply* to, vector<float>& deviation) {
+	deviationStats stats;
+	int vertexCount = from->getVertexCount();
+	int sampleCount = vertexCount + (sampleFaces ? from->getFaceCount() : 0);
+	deviation.assign(vertexCount, 0.0f);
+	if (sampleCount == 0 || to->getFaceCount() == 0) {
+		return stats;
+	}
+
+	// the BVH of to, unless the memory budget left it out
+	bvh localTree;
+	bvh* tree = to->getBVH();
+	if (tree->getNodeCount() == 0) {
+		localTree.build(to);
+		tree = &localTree;
+	}
+
+	// from's normalized space to to's
+	float scale = from->getOriginalScale() / to->getOriginalScale();
+	glm::vec3 offset = (from->getOriginalCenter() - to->getOriginalCenter()) / to->getOriginalScale();
+	float units = to->getOriginalScale();
+
+	mutex statsLock;
+	double largest = 0.0, sum = 0.0, sumSquares = 0.0;
+	parallelFor(0, sampleCount, 1024, [&](int start, int end) {
+		double chunkLargest = 0.0, chunkSum = 0.0, chunkSquares = 0.0;
+		bool havePrevious = false;
+		glm::vec3 previous(0.0f);
+		for (int i = start; i < end; i++) {
+			glm::vec3 position;
+			if (i < vertexCount) {
+				position = from->getVertex(i)->position;
+			}
+			else {
+				const int* corners = from->getFace(i - vertexCount)->vertexList;
+				position = (from->getVertex(corners[0])->position + from->getVertex(corners[1])->position
+					+ from->getVertex(corners[2])->position) / 3.0f;
+			}
+			glm::vec3 point = position * scale + offset;
+
+			rayHit hit;
+			// a little slack so rounding cannot lose the previous point
+			float bound = havePrevious ? glm::length(previous - point) * 1.0001f + 1e-6f : FLT_MAX;
+			if (!tree->closestPoint(point, bound, hit) && !tree->closestPoint(point, FLT_MAX, hit)) {
+				continue;
+			}
+			previous = hit.position;
+			havePrevious = true;
+
+			double distance = (double)hit.t * units;
+			if (i < vertexCount) {
+				deviation[i] = (float)distance;
+			}
+			chunkLargest = max(chunkLargest, distance);
+			chunkSum += distance;
+			chunkSquares += distance * distance;
+		}
+
+		lock_guard<mutex> lock(statsLock);
+		largest = max(largest, chunkLargest);
+		sum += chunkSum;
+		sumSquares += chunkSquares;
+	});
+
+	stats.samples = sampleCount;
+	stats.hausdorff = largest;
+	stats.mean = sum / sampleCount;
+	stats.rms = sqrt(sumSquares / sampleCount);
+	return stats;
+}
+
+deviationStats meshComparer::compareBoth(ply* a, ply* b) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	forward = compare(a, b, deviationA);
+	backward = compare(b, a, deviationB);
+
+	deviationStats both;
+	both.samples = forward.samples + backward.samples;
+	both.hausdorff = max(forward.hausdorff, backward.hausdorff);
+	if (both.samples > 0) {
+		both.mean = (forward.mean * forward.samples + backward.mean * backward.samples) / both.samples;
+		both.rms = sqrt((forward.rms * forward.rms * forward.samples
+			+ backward.rms * backward.rms * backward.samples) / both.samples);
+	}
+	lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return both;
+}
+
+void meshComparer::colorMap(const vector<float>& deviation, float maxDeviation, vector<glm::vec3>& colors) {
+	colors.resize(deviation.size());
+	for (size_t i = 0; i < deviation.size(); i++) {
+		float value = maxDeviation > 0.0f ? fmin(fmax(deviation[i] / maxDeviation, 0.0f), 1.0f) : 0.0f;
+		// blue to green over the first half, green to red over the second
+		if (value < 0.5f) {
+			colors[i] = glm::vec3(0.0f, 2.0f * value, 1.0f - 2.0f * value);
+		}
+		else {
+			colors[i] = glm::vec3(2.0f * value - 1.0f, 2.0f - 2.0f * value, 0.0f);
+		}
+	}
+}
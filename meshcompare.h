@@ -0,0 +1,87 @@
+/*  =================== File Information =================
+        File Name: meshcompare.h
+        Description: Hausdorff and RMS deviation between two meshes
+
+        Purpose:        Measure how far a simplified model strays from
+                        the full one (happy.ply / happy_low.ply,
+                        bunny.ply / bunny_low.ply), in the units of the
+                        original files, and show where per vertex
+        Examples:       See example below for using meshComparer
+        ===================================================== */
+#ifndef MESHCOMPARE_H
+#define MESHCOMPARE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== deviationStats ==============
+        Purpose: Distances from the samples of one mesh to the surface
+        of another, in the units of the files. hausdorff is the
+        largest, rms the root mean square.
+        ==================================== */
+struct deviationStats {
+        double hausdorff;
+        double mean;
+        double rms;
+        long samples;
+
+        deviationStats() : hausdorff(0), mean(0), rms(0), samples(0) {}
+};
+
+/*  ============== meshComparer ==============
+        Purpose: One-sided and symmetric deviation between two meshes
+
+        Every vertex of one mesh, and with sampleFaces the centroid of
+        every face as well, is sent to the closest point of the other
+        mesh's surface through its face BVH. Each mesh was normalized on
+        its own at load, so samples are taken back to file coordinates
+        (ply::getOriginalCenter / getOriginalScale) and then into the
+        other mesh's normalized space. Samples are spread over the worker
+        pool.
+
+        The symmetric Hausdorff distance is the larger of the two
+        one-sided ones; its mean and rms pool the samples of both sides.
+
+        Example usage:
+        1.) meshComparer comparer;
+        2.) deviationStats both = comparer.compareBoth(fullPLY, lowPLY);
+        3.) meshComparer::colorMap(comparer.deviationA, comparer.forward.hausdorff, colors);
+            fullPLY->renderColored(colors);
+        ==================================== */
+class meshComparer {
+public:
+        meshComparer();
+
+        /*      ===============================================
+                Desc: Deviation of from from the surface of to.
+                deviation gets the distance of every vertex of from.
+        =============================================== */
+        deviationStats compare(ply* from, ply* to, vector<float>& deviation);
+        /*      ===============================================
+                Desc: Both one-sided comparisons (into forward, backward,
+                deviationA and deviationB), returning the symmetric one
+        =============================================== */
+        deviationStats compareBoth(ply* a, ply* b);
+
+        /*      ===============================================
+                Desc: One colour per value, blue at 0 through green to
+                red at maxDeviation and above
+        =============================================== */
+        static void colorMap(const vector<float>& deviation, float maxDeviation, vector<glm::vec3>& colors);
+
+        // sample face centroids as well as vertices
+        bool sampleFaces;
+
+        // what the last compareBoth() found: a to b, b to a, and the
+        // distance of each vertex of a and of b to the other mesh
+        deviationStats forward;
+        deviationStats backward;
+        vector<float> deviationA;
+        vector<float> deviationB;
+        double lastSeconds;
+};
+
+#endif
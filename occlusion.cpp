@@ -0,0 +1,202 @@
+/*  =================== File Information =================
+  File Name: occlusion.cpp
+  Description: Bakes, caches and loads per-vertex ambient occlusion
+  ===================================================== */
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include "occlusion.h"
+#include "parallel.h"
+
+using namespace std;
+
+static const float RAY_OFFSET = 1e-4f;
+
+occlusionBaker::occlusionBaker() {
+	rayCount = 64;
+	maxDistance = 0.25f;
+	lastFromCache = false;
+	lastSeconds = 0.0;
+	cancel = false;
+}
+
+string occlusionBaker::cachePath(ply* mesh) {
+	return mesh->getFilePath() + ".ao";
+}
+
+bool occlusionBaker::apply(ply* mesh) {
+	vector<float> occlusion;
+	if (!compute(mesh, occlusion)) {
+		return false;
+	}
+	mesh->setAmbientOcclusion(occlusion);
+	return true;
+}
+
+bool occlusionBaker::compute(ply* mesh, vector<float>& occlusion) {
+	if (mesh->getVertexCount() == 0) {
+		return false;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	lastFromCache = loadCache(mesh, occlusion);
+	if (!lastFromCache) {
+		if (!bake(mesh, occlusion)) {
+			return false;
+		}
+		saveCache(mesh, occlusion);
+	}
+	lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+// bit-reversal of i, as a fraction in [0, 1)
+static float radicalInverse(unsigned int i) {
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x55555555u) << 1) | ((i & 0xAAAAAAAAu) >> 1);
+	i = ((i & 0x33333333u) << 2) | ((i & 0xCCCCCCCCu) >> 2);
+	i = ((i & 0x0F0F0F0Fu) << 4) | ((i & 0xF0F0F0F0u) >> 4);
+	i = ((i & 0x00FF00FFu) << 8) | ((i & 0xFF00FF00u) >> 8);
+	return (float)(i * 2.3283064365386963e-10);
+}
+
+// a repeatable pseudo-random fraction per vertex, to rotate its samples
+static float hashFraction(unsigned int i) {
+	i ^= i >> 16;
+	i *= 0x7feb352du;
+	i ^= i >> 15;
+	i *= 0x846ca68bu;
+	i ^= i >> 16;
+	return (float)(i * 2.3283064365386963e-10);
+}
+
+/*  ===============================================
+	  Desc: Bakes occlusion for every vertex of mesh into occlusion
+	  Vertex normals are the area-weighted average of the face normals.
+	  Each vertex uses the same Hammersley point set, rotated by a
+	  per-vertex offset so neighbouring vertices do not band together.
+	  Returns false if cancel is set before it is done.
+	=============================================== */
+bool occlusionBaker::bake(ply* mesh, vector<float>& occlusion) {
+	int vertexCount = mesh->getVertexCount();
+	int faceCount = mesh->getFaceCount();
+	occlusion.assign(vertexCount, 1.0f);
+
+	// the mesh's own BVH, unless the memory budget left it out
+	bvh localTree;
+	bvh* tree = mesh->getBVH();
+	if (tree->getNodeCount() == 0) {
+		localTree.build(mesh);
+		tree = &localTree;
+	}
+
+	vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+	for (int i = 0; i < faceCount; i++) {
+		face* f = mesh->getFace(i);
+		glm::vec3 a = mesh->getVertex(f->vertexList[0])->position;
+		glm::vec3 b = mesh->getVertex(f->vertexList[1])->position;
+		glm::vec3 c = mesh->getVertex(f->vertexList[2])->position;
+		// the cross product's length is twice the area
+		glm::vec3 weighted = glm::cross(b - a, c - a);
+		for (int j = 0; j < 3; j++) {
+			normals[f->vertexList[j]] = normals[f->vertexList[j]] + weighted;
+		}
+	}
+
+	int packets = (rayCount + 3) / 4;
+	parallelFor(0, vertexCount, 256, [&](int start, int end) {
+		rayPacket packet;
+		for (int v = start; v < end && !cancel; v++) {
+			float length = glm::length(normals[v]);
+			if (length == 0.0f) {
+				continue;
+			}
+			glm::vec3 normal = normals[v] / length;
+			glm::vec3 tangent = fabs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			tangent = glm::normalize(glm::cross(tangent, normal));
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+			glm::vec3 origin = mesh->getVertex(v)->position + normal * RAY_OFFSET;
+			float shiftU = hashFraction(2 * v);
+			float shiftV = hashFraction(2 * v + 1);
+
+			int blocked = 0;
+			int cast = 0;
+			for (int p = 0; p < packets; p++) {
+				int active = 0;
+				for (int k = 0; k < 4; k++) {
+					int i = 4 * p + k;
+					packet.originX[k] = origin.x;
+					packet.originY[k] = origin.y;
+					packet.originZ[k] = origin.z;
+					packet.minT[k] = RAY_OFFSET;
+					packet.maxT[k] = maxDistance;
+					float u = fmod((i + 0.5f) / rayCount + shiftU, 1.0f);
+					float w = fmod(radicalInverse(i) + shiftV, 1.0f);
+					// cosine-weighted direction around the normal
+					float radius = sqrt(u);
+					float angle = 6.28318531f * w;
+					glm::vec3 direction = tangent * (radius * cos(angle)) + bitangent * (radius * sin(angle))
+						+ normal * sqrt(fmax(0.0f, 1.0f - u));
+					packet.directionX[k] = direction.x;
+					packet.directionY[k] = direction.y;
+					packet.directionZ[k] = direction.z;
+					if (i < rayCount) {
+						active |= 1 << k;
+						cast++;
+					}
+				}
+				int hits = tree->occluded(packet, active);
+				for (int k = 0; k < 4; k++) {
+					blocked += (hits >> k) & 1;
+				}
+			}
+			occlusion[v] = 1.0f - (float)blocked / (float)cast;
+		}
+	});
+	return !cancel;
+}
+
+/*  ===============================================
+	  Desc: Cache format: a text line "plyao 1 <vertices> <rays>
+	  <distance>" followed by one float per vertex in the byte order of
+	  this machine. The cache is used only if it is newer than the model
+	  and was baked for the same vertex count and settings.
+	=============================================== */
+bool occlusionBaker::loadCache(ply* mesh, vector<float>& occlusion) {
+	string path = cachePath(mesh);
+	struct stat modelInfo, cacheInfo;
+	if (stat(path.c_str(), &cacheInfo) != 0 || stat(mesh->getFilePath().c_str(), &modelInfo) != 0
+		|| cacheInfo.st_mtime < modelInfo.st_mtime) {
+		return false;
+	}
+
+	ifstream in(path.c_str(), ios::in | ios::binary);
+	string magic;
+	int version = 0, vertices = 0, rays = 0;
+	float distance = 0.0f;
+	in >> magic >> version >> vertices >> rays >> distance;
+	if (!in || magic != "plyao" || version != 1 || vertices != mesh->getVertexCount()
+		|| rays != rayCount || fabs(distance - maxDistance) > 1e-6f) {
+		return false;
+	}
+	in.get();
+
+	occlusion.resize(vertices);
+	in.read((char*)occlusion.data(), (streamsize)vertices * sizeof(float));
+	return (bool)in;
+}
+
+bool occlusionBaker::saveCache(ply* mesh, const vector<float>& occlusion) {
+	string path = cachePath(mesh);
+	ofstream out(path.c_str(), ios::out | ios::binary);
+	if (!out.is_open()) {
+		cout << "cannot write occlusion cache " << path << "\n";
+		return false;
+	}
+	out << "plyao 1 " << occlusion.size() << " " << rayCount << " " << maxDistance << "\n";
+	out.write((const char*)occlusion.data(), (streamsize)occlusion.size() * sizeof(float));
+	return (bool)out;
+}
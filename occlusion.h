@@ -0,0 +1,73 @@
+/*  =================== File Information =================
+        File Name: occlusion.h
+        Description: Per-vertex ambient occlusion baked with the face BVH
+
+        Purpose:        Darken creases and cavities of dense scans without
+                        any per-frame cost: occlusion is computed once per
+                        vertex, kept next to the model on disk, and only
+                        modulates the vertex colours when drawing
+        Examples:       See example below for using occlusionBaker
+        ===================================================== */
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== occlusionBaker ==============
+        Purpose: Casts rayCount rays over the hemisphere around every
+        vertex normal (cosine weighted) and records the fraction that
+        escape within maxDistance (the mesh is normalized to about one
+        unit). 1 is fully open, 0 fully enclosed.
+
+        Vertices are spread over the worker pool; each vertex traces its
+        rays four at a time as bvh ray packets. The result is cached in
+        <model>.ao and reused while the model is older than the cache and
+        the settings match.
+
+        compute() does the same without touching the mesh, so it can run
+        on a thread of its own while the mesh is drawn; setting cancel
+        from another thread stops it early.
+
+        Example usage:
+        1.) occlusionBaker baker;
+        2.) baker.apply(myPLY);        // cached or baked, then set on the mesh
+        3.) myPLY->render(0, true);
+        ==================================== */
+class occlusionBaker {
+public:
+        occlusionBaker();
+
+        /*      ===============================================
+                Desc: Gives mesh its occlusion, from the cache if it is
+                valid, otherwise by baking and writing the cache.
+                Returns false if the mesh is empty.
+        =============================================== */
+        bool apply(ply* mesh);
+        /*      ===============================================
+                Desc: What apply gives mesh, into occlusion instead.
+                Returns false if the mesh is empty or cancel was set.
+        =============================================== */
+        bool compute(ply* mesh, vector<float>& occlusion);
+
+        // false if cancel was set before every vertex was baked
+        bool bake(ply* mesh, vector<float>& occlusion);
+        bool loadCache(ply* mesh, vector<float>& occlusion);
+        bool saveCache(ply* mesh, const vector<float>& occlusion);
+        static string cachePath(ply* mesh);
+
+        // tuning
+        int rayCount;
+        float maxDistance;
+
+        // what the last apply() or compute() did
+        bool lastFromCache;
+        double lastSeconds;
+        atomic<bool> cancel;
+};
+
+#endif
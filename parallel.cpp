@@ -0,0 +1,248 @@
+/*  =================== File Information =================
+  File Name: parallel.cpp
+  Description: Worker pool behind taskGroup and parallelFor
+  ===================================================== */
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "parallel.h"
+
+using namespace std;
+
+// A queued task is listed both in the pool's queue and in its group's
+// queue. Whichever thread takes it first marks it taken; the other queue
+// drops the entry when it reaches one of its ends.
+struct taskGroup::queuedTask {
+	function<void()> work;
+	bool taken;
+};
+
+/*  ============== workerPool ==============
+	Purpose: One queue of tasks shared by a fixed set of worker threads.
+	Workers take the oldest task of any group; a waiting taskGroup takes
+	the newest of its own queue.
+	Created on first use and lives until the program exits.
+	==================================== */
+class workerPool {
+public:
+	typedef shared_ptr<taskGroup::queuedTask> taskRef;
+
+	workerPool(int threadCount) {
+		stopping = false;
+		for (int i = 0; i < threadCount - 1; i++) {
+			workers.push_back(thread([this]() { workerLoop(); }));
+		}
+	}
+
+	~workerPool() {
+		{
+			lock_guard<mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueReady.notify_all();
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	void push(function<void()> task, taskGroup* group) {
+		taskRef queued = make_shared<taskGroup::queuedTask>();
+		queued->work = task;
+		queued->taken = false;
+		{
+			lock_guard<mutex> lock(queueMutex);
+			tasks.push_back(queued);
+			group->queued.push_back(queued);
+		}
+		queueReady.notify_all();
+	}
+
+	/*  ===============================================
+		  Desc: Runs one of group's queued tasks on the calling thread.
+		  Only the group's own tasks are taken, so a thread waiting for a
+		  small parallel loop never picks up, say, a whole other file.
+		  Returns false (without waiting) if none are queued.
+		=============================================== */
+	bool runOne(taskGroup* group) {
+		function<void()> task;
+		{
+			lock_guard<mutex> lock(queueMutex);
+			if (!hasTask(group)) {
+				return false;
+			}
+			task = take(group->queued.back());
+			group->queued.pop_back();
+			// with no workers, nothing else clears the pool's queue
+			dropTaken(tasks);
+		}
+		task();
+		return true;
+	}
+
+	// Sleeps until one of group's tasks is queued or the group finishes
+	void waitForWork(taskGroup* group, atomic<int>& pending) {
+		unique_lock<mutex> lock(queueMutex);
+		queueReady.wait(lock, [&]() { return hasTask(group) || pending.load() == 0 || stopping; });
+	}
+
+	void notifyAll() {
+		lock_guard<mutex> lock(queueMutex);
+		queueReady.notify_all();
+	}
+
+private:
+	// caller holds queueMutex (as for the helpers below)
+	static function<void()> take(const taskRef& queued) {
+		function<void()> work;
+		swap(work, queued->work);
+		queued->taken = true;
+		return work;
+	}
+
+	// A group's taken tasks sit at the ends of its queue: workers take
+	// the oldest, the waiting thread the newest. Those a waiting thread
+	// took from the middle of the pool's queue go once workers reach them.
+	static void dropTaken(deque<taskRef>& queue) {
+		while (!queue.empty() && queue.front()->taken) {
+			queue.pop_front();
+		}
+		while (!queue.empty() && queue.back()->taken) {
+			queue.pop_back();
+		}
+	}
+
+	static bool hasTask(taskGroup* group) {
+		dropTaken(group->queued);
+		return !group->queued.empty();
+	}
+
+	void workerLoop() {
+		while (true) {
+			function<void()> task;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueReady.wait(lock, [this]() {
+					dropTaken(tasks);
+					return !tasks.empty() || stopping;
+				});
+				if (stopping && tasks.empty()) {
+					return;
+				}
+				task = take(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	vector<thread> workers;
+	deque<taskRef> tasks;
+	mutex queueMutex;
+	condition_variable queueReady;
+	bool stopping;
+};
+
+static int requestedThreads = 0;
+
+int getThreadCount() {
+	if (requestedThreads > 0) {
+		return requestedThreads;
+	}
+	int hardware = (int)thread::hardware_concurrency();
+	return hardware > 0 ? hardware : 1;
+}
+
+void setThreadCount(int count) {
+	requestedThreads = count;
+}
+
+static workerPool& pool() {
+	static workerPool instance(getThreadCount());
+	return instance;
+}
+
+taskGroup::taskGroup() : pending(0) {
+}
+
+taskGroup::~taskGroup() {
+	finish();
+}
+
+void taskGroup::run(function<void()> task) {
+	pending++;
+	pool().push([this, task]() {
+		try {
+			task();
+		}
+		catch (...) {
+			lock_guard<mutex> lock(errorLock);
+			if (!error) {
+				error = current_exception();
+			}
+		}
+		if (--pending == 0) {
+			pool().notifyAll();
+		}
+	}, this);
+}
+
+void taskGroup::wait() {
+	finish();
+	exception_ptr failed;
+	{
+		lock_guard<mutex> lock(errorLock);
+		swap(failed, error);
+	}
+	if (failed) {
+		rethrow_exception(failed);
+	}
+}
+
+// waits for every task of the group without rethrowing
+void taskGroup::finish() {
+	while (pending.load() > 0) {
+		if (!pool().runOne(this)) {
+			pool().waitForWork(this, pending);
+		}
+	}
+}
+
+void parallelChunks(int begin, int end, int chunkCount, const function<void(int, int, int)>& body) {
+	if (chunkCount <= 1 || end - begin <= 1) {
+		body(0, begin, end);
+		return;
+	}
+
+	taskGroup group;
+	long long count = end - begin;
+	for (int c = 1; c < chunkCount; c++) {
+		int start = begin + (int)(count * c / chunkCount);
+		int stop = begin + (int)(count * (c + 1) / chunkCount);
+		group.run([&body, c, start, stop]() { body(c, start, stop); });
+	}
+	// the calling thread takes the first chunk itself
+	body(0, begin, begin + (int)(count / chunkCount));
+	group.wait();
+}
+
+void parallelFor(int begin, int end, int grain, const function<void(int, int)>& body) {
+	int count = end - begin;
+	if (grain < 1) {
+		grain = 1;
+	}
+	if (count <= grain || getThreadCount() == 1) {
+		if (count > 0) {
+			body(begin, end);
+		}
+		return;
+	}
+
+	// a few chunks per thread so uneven chunks still balance out
+	int chunks = min(count / grain, getThreadCount() * 4);
+	parallelChunks(begin, end, chunks, [&body](int, int start, int stop) {
+		if (stop > start) {
+			body(start, stop);
+		}
+	});
+}
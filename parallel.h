@@ -0,0 +1,133 @@
+/*  =================== File Information =================
+        File Name: parallel.h
+        Description: Shared worker pool and parallel loop helpers
+
+        Purpose:        Spread per-face / per-vertex / per-file work over
+                        every core without oversubscribing when loops nest
+        Examples:       See example below for using parallelFor
+        ===================================================== */
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+/*  ============== taskGroup ==============
+        Purpose: A set of tasks submitted to the shared worker pool that
+        can be waited on together.
+
+        wait() runs the group's queued tasks on the calling thread until
+        every task of the group is done, so a task may itself start a
+        taskGroup (e.g. one task per file, then a parallel loop inside each
+        file) without deadlocking or spawning extra threads.
+
+        If a task throws (std::bad_alloc on a model too big for the
+        machine), the rest still run and wait() rethrows the first
+        exception once they are done. The destructor waits but does
+        not rethrow.
+
+        Example usage:
+        1.) taskGroup group;
+        2.) group.run([&]() { processFile(name); });
+        3.) group.wait();
+        ==================================== */
+class taskGroup {
+public:
+        taskGroup();
+        ~taskGroup();
+
+        void run(function<void()> task);
+        void wait();
+
+private:
+        friend class workerPool;
+        struct queuedTask;
+
+        void finish();
+
+        atomic<int> pending;
+        // the group's own queue, so wait() finds its tasks without
+        // searching the pool's; guarded by the pool's lock
+        deque<shared_ptr<queuedTask>> queued;
+        mutex errorLock;
+        exception_ptr error;
+};
+
+/*  ===============================================
+        Desc: Number of threads that take part in parallel work
+        (the pool's workers plus the waiting thread)
+        setThreadCount only has an effect before the pool is first used
+        =============================================== */
+int getThreadCount();
+void setThreadCount(int count);
+
+/*  ===============================================
+        Desc: Calls body(start, end) on disjoint sub-ranges covering
+        [begin, end) in parallel. Ranges shorter than grain run inline.
+        Example: parallelFor(0, faceCount, 1024, [&](int start, int end) {...});
+        =============================================== */
+void parallelFor(int begin, int end, int grain, const function<void(int, int)>& body);
+
+/*  ===============================================
+        Desc: Like parallelFor but splits [begin, end) into exactly
+        chunkCount sub-ranges and passes the chunk number, so that each
+        chunk can write its partial result (sum, max, count) to its own
+        slot without locking
+        =============================================== */
+void parallelChunks(int begin, int end, int chunkCount, const function<void(int, int, int)>& body);
+
+/*  ===============================================
+        Desc: Merges the sorted ranges [bounds[i], bounds[i + 1]) of
+        first, which lie next to each other, into one sorted range.
+        Neighbouring ranges are merged pairwise, the pairs of a round in
+        parallel, so r ranges take log2(r) rounds.
+        =============================================== */
+template <class T, class Compare>
+void parallelMergeRanges(T* first, const vector<int>& bounds, Compare comp) {
+        int ranges = (int)bounds.size() - 1;
+        for (int width = 1; width < ranges; width *= 2) {
+                taskGroup group;
+                for (int c = 0; c + width < ranges; c += 2 * width) {
+                        int lo = bounds[c];
+                        int mid = bounds[c + width];
+                        int hi = bounds[min(c + 2 * width, ranges)];
+                        group.run([=]() { inplace_merge(first + lo, first + mid, first + hi, comp); });
+                }
+                group.wait();
+        }
+}
+
+/*  ===============================================
+        Desc: Sorts [first, last) by sorting chunks in parallel and then
+        merging neighbouring chunks pairwise, also in parallel
+        =============================================== */
+template <class T, class Compare>
+void parallelSort(T* first, T* last, Compare comp) {
+        int count = (int)(last - first);
+        int chunks = getThreadCount() * 2;
+        if (count < 65536 || chunks < 2) {
+                sort(first, last, comp);
+                return;
+        }
+
+        vector<int> bounds(chunks + 1);
+        for (int c = 0; c <= chunks; c++) {
+                bounds[c] = (int)((long long)count * c / chunks);
+        }
+        parallelChunks(0, chunks, chunks, [&](int, int start, int end) {
+                for (int c = start; c < end; c++) {
+                        sort(first + bounds[c], first + bounds[c + 1], comp);
+                }
+        });
+        parallelMergeRanges(first, bounds, comp);
+}
+
+#endif
@@ -5,20 +5,159 @@
   Author: Paul Nixon
   ===================================================== */
 #define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cstring>
 #include <stdio.h>
 #include <cstdlib>
 #include <FL/gl.h>
 #include "ply.h"
 #include "geometry.h"
+#include "parallel.h"
+#include "plyformat.h"
+#include "plystream.h"
 #include <math.h>
 #include <glm/gtc/type_ptr.hpp>
 
 
 using namespace std;
 
+// records read between two updates of the progressive preview; batches
+// start small so the first points show quickly, then grow
+static const int FIRST_LOAD_BATCH = 1 << 16;
+static const int MAX_LOAD_BATCH = 1 << 20;
+
+// feature edges are drawn from one display list per degree of angle,
+// from the lowest threshold the feature angle slider offers up to 180
+static const int MIN_FEATURE_ANGLE = 1;
+static const int FEATURE_LISTS = 180 - MIN_FEATURE_ANGLE;
+
+// a face is degenerate if the sine of its angle at the first corner is
+// below this, where float rounding alone can put it
+static const float DEGENERATE_SINE = 1e-6f;
+
+static size_t meshMemoryBudget = 0;
+
+void setMeshMemoryBudget(size_t bytes) {
+	meshMemoryBudget = bytes;
+}
+
+size_t getMeshMemoryBudget() {
+	return meshMemoryBudget;
+}
+
+static bool meshCleanup = false;
+static float meshWeldTolerance = 0.0f;
+
+void setMeshCleanup(bool enabled, float weldTolerance) {
+	meshCleanup = enabled;
+	meshWeldTolerance = weldTolerance > 0.0f ? weldTolerance : 0.0f;
+}
+
+bool getMeshCleanup() {
+	return meshCleanup;
+}
+
+float getMeshWeldTolerance() {
+	return meshWeldTolerance;
+}
+
+// keys sort by vertex pair, then by face
+static bool edgeKeyLess(const edgeKey& a, const edgeKey& b) {
+	return a.vertices < b.vertices || (a.vertices == b.vertices && a.face < b.face);
+}
+
+// writes the three edge keys of f, which is face number index, to keys
+// and returns 3; returns 0 for a face that points outside the vertex
+// list (it is dropped later)
+static int writeEdgeKeys(const face* f, int index, int vertexCount, edgeKey* keys) {
+	for (int j = 0; j < 3; j++) {
+		if (f->vertexList[j] < 0 || f->vertexList[j] >= vertexCount) {
+			return 0;
+		}
+	}
+	for (int j = 0; j < 3; j++) {
+		unsigned int a = (unsigned int)f->vertexList[j];
+		unsigned int b = (unsigned int)f->vertexList[(j + 1) % 3];
+		keys[j].vertices = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+		keys[j].face = index;
+		keys[j].corner = j;
+	}
+	return 3;
+}
+
+// a vertex in the weld grid: the hash of its cell, then its index
+struct weldKey {
+	unsigned long long cell;
+	int vertex;
+};
+
+static bool weldKeyLess(const weldKey& a, const weldKey& b) {
+	return a.cell < b.cell || (a.cell == b.cell && a.vertex < b.vertex);
+}
+
+// a face by its three vertices in increasing order, so both windings of
+// the same triangle get the same key
+struct faceKey {
+	int corners[3];
+	int face;
+};
+
+static bool faceKeyLess(const faceKey& a, const faceKey& b) {
+	for (int j = 0; j < 3; j++) {
+		if (a.corners[j] != b.corners[j]) {
+			return a.corners[j] < b.corners[j];
+		}
+	}
+	return a.face < b.face;
+}
+
+static unsigned long long cellHash(long long x, long long y, long long z) {
+	unsigned long long h = (unsigned long long)x * 0x9E3779B97F4A7C15ULL;
+	h ^= (unsigned long long)y * 0xC2B2AE3D27D4EB4FULL + (h << 6) + (h >> 2);
+	h ^= (unsigned long long)z * 0x165667B19E3779F9ULL + (h << 6) + (h >> 2);
+	// the table below indexes by the low bits
+	return h ^ (h >> 29);
+}
+
+/*  ===============================================
+	  Desc: The weld cell of a position: a cube twice the tolerance
+	  wide, so everything within tolerance is in this cell or the next
+	  one towards the nearer side on each axis, which goes to side.
+	  With no tolerance the cell is the bits of the position itself, so
+	  only equal positions share a cell.
+	=============================================== */
+static void weldCell(const glm::vec3& position, float tolerance, long long cell[3], int side[3]) {
+	for (int j = 0; j < 3; j++) {
+		if (tolerance > 0.0f) {
+			float scaled = position[j] / (2.0f * tolerance);
+			float corner = floor(scaled);
+			cell[j] = (long long)corner;
+			side[j] = scaled - corner < 0.5f ? -1 : 1;
+		}
+		else {
+			// -0 and 0 are the same point
+			float value = position[j] + 0.0f;
+			unsigned int bits;
+			memcpy(&bits, &value, sizeof(bits));
+			cell[j] = bits;
+			side[j] = 0;
+		}
+	}
+}
+
+// reserved but unused bytes of a vector's buffer
+template <typename T>
+static size_t vectorSlack(const vector<T>& v) {
+	return (v.capacity() - v.size()) * sizeof(T);
+}
+
 /*  ===============================================
 	  Desc: Default constructor for a ply object
 	  Precondition: _filePath is set to a valid filesystem location
@@ -33,6 +172,22 @@ ply::ply() {
 	vertexCount = 0;
 	faceCount = 0;
 	edgeCount = 0;
+	displayList = 0;
+	displayListBytes = 0;
+	featureLists = 0;
+	featureListBytes = 0;
+	edgesEnabled = true;
+	bvhEnabled = true;
+	faceBVH = new bvh();
+	loading = false;
+	cancelLoad = false;
+	loadSucceeded = false;
+	loadingVertices = NULL;
+	loadedVertices = 0;
+	previewCenter = glm::vec3(0.0f);
+	previewScale = 1.0f;
+	originalCenter = glm::vec3(0.0f);
+	originalScale = 1.0f;
 	// Call helper function to load geometry
 	//loadGeometry();
 }
@@ -42,7 +197,10 @@ ply::ply() {
 	  Precondition: Memory has been already allocated
 	  =============================================== */
 ply::~ply() {
+	cancelLoad = true;
+	finishLoad();
 	deconstruct();
+	delete faceBVH;
 }
 
 void ply::deconstruct() {
@@ -67,6 +225,15 @@ void ply::deconstruct() {
 	if (edgeList)
 		delete[] edgeList;
 
+	if (displayList)
+		glDeleteLists(displayList, 1);
+	if (featureLists)
+		glDeleteLists(featureLists, FEATURE_LISTS);
+	faceBVH->clear();
+	vector<float>().swap(ambientOcclusion);
+	vector<int>().swap(featureEdges);
+	vector<float>().swap(featureAngles);
+
 	// Set pointers to NULL
 	vertexList = NULL;
 	faceList = NULL;
@@ -75,184 +242,773 @@ void ply::deconstruct() {
 	vertexCount = 0;
 	faceCount = 0;
 	edgeCount = 0;
+	displayList = 0;
+	displayListBytes = 0;
+	featureLists = 0;
+	featureListBytes = 0;
+	originalCenter = glm::vec3(0.0f);
+	originalScale = 1.0f;
+	edgesEnabled = true;
+	bvhEnabled = true;
 }
 
 /*  ===============================================
 	  Desc: reloads the geometry for a 3D object
 			(or loads a different file)
+	  Returns false (and leaves the object empty) if the file cannot be read
 	=============================================== */
-void ply::reload(string _filePath) {
+bool ply::reload(string _filePath) {
 
+	cancelLoad = true;
+	finishLoad();
+	cancelLoad = false;
 	filePath = _filePath;
 	deconstruct();
 	// Call our function again to load new vertex and face information.
-	loadGeometry();
+	loadSucceeded = loadGeometryOrFail();
+	return loadSucceeded;
+}
+
+/*  ===============================================
+	  Desc: loadGeometry, turning running out of memory part way (a
+	  model too big for the machine) into a failed load of this file
+	  rather than the end of the program
+	=============================================== */
+bool ply::loadGeometryOrFail() {
+	try {
+		return loadGeometry();
+	}
+	catch (const bad_alloc&) {
+		cout << "cannot load " << filePath.c_str() << ": out of memory\n";
+		deconstruct();
+		return false;
+	}
+}
+
+/*  ===============================================
+	  Desc: Starts loading _filePath on a background thread and returns
+	  at once. Until the load finishes the object draws nothing through
+	  the usual calls; renderProgress shows what has been read so far.
+	=============================================== */
+void ply::beginLoad(string _filePath) {
+	// a load still running is for a file nobody wants any more
+	cancelLoad = true;
+	finishLoad();
+	filePath = _filePath;
+	deconstruct();
+	cancelLoad = false;
+	loading = true;
+	loader = thread([this]() {
+		loadSucceeded = loadGeometryOrFail();
+		loading = false;
+	});
+}
+
+/*  ===============================================
+	  Desc: Waits for a load started by beginLoad
+	  Returns whether the last load (either kind) succeeded
+	=============================================== */
+bool ply::finishLoad() {
+	if (loader.joinable()) {
+		loader.join();
+	}
+	return loadSucceeded;
+}
+
+int ply::getLoadedVertexCount() {
+	lock_guard<mutex> lock(loadLock);
+	return loadingVertices == NULL ? vertexCount : loadedVertices;
+}
+
+/*  ===============================================
+	  Desc: Draws the part of a background load read so far: the
+	  vertices as points and the faces read so far as triangles,
+	  normalized with the estimate from the first vertex batch.
+	  Draws the finished mesh once loading is done.
+	  Precondition: a GL context is current
+	=============================================== */
+void ply::renderProgress() {
+	unique_lock<mutex> lock(loadLock);
+	if (loadingVertices == NULL) {
+		// before the vertex element nothing has been read yet; render()
+		// pushes a matrix only when there is a mesh to draw
+		bool finished = vertexList != NULL && faceList != NULL;
+		lock.unlock();
+		if (finished) {
+			render();
+			glPopMatrix();
+		}
+		return;
+	}
+
+	glPushMatrix();
+	glScalef(previewScale, previewScale, previewScale);
+	glTranslatef(-previewCenter.x, -previewCenter.y, -previewCenter.z);
+
+	glBegin(GL_TRIANGLES);
+	for (size_t i = 0; i < loadingFaces.size(); i++) {
+		const int* corners = loadingFaces[i]->vertexList;
+		if (corners[0] < 0 || corners[0] >= loadedVertices || corners[1] < 0 || corners[1] >= loadedVertices
+			|| corners[2] < 0 || corners[2] >= loadedVertices) {
+			continue;
+		}
+		glNormal3fv(glm::value_ptr(loadingFaces[i]->faceNormal));
+		for (int j = 0; j < 3; j++) {
+			glVertex3fv(glm::value_ptr(loadingVertices[corners[j]]->position));
+		}
+	}
+	glEnd();
+
+	// the point cloud stays up until the faces cover it
+	glPushAttrib(GL_LIGHTING_BIT);
+	glDisable(GL_LIGHTING);
+	glBegin(GL_POINTS);
+	for (int i = 0; i < loadedVertices; i++) {
+		glVertex3fv(glm::value_ptr(loadingVertices[i]->position));
+	}
+	glEnd();
+	glPopAttrib();
+
+	glPopMatrix();
 }
 /*  ===============================================
 	  Desc: Loads the data structures (look at geometry.h and ply.h)
 	  Precondition: filePath is something valid, arrays are NULL
 	  Postcondition: data structures are filled
 		  (including edgeList, this calls scaleAndCenter and findEdges)
+	  Returns false if the file could not be opened or parsed
+
+	  Vertices and faces are read in batches. After each batch the part
+	  read so far is published (under loadLock) for renderProgress, so a
+	  background load started by beginLoad can be watched as it goes.
+	  The object itself only takes the geometry over at the end.
+
+	  The loader is a pipeline: this thread only parses, and every batch
+	  it finishes is handed to the worker pool while it parses the next.
+	  A vertex batch is measured (sum and bounds); a face batch gets its
+	  normals from the raw positions (a uniform rescale does not change
+	  them) and emits and sorts its edge keys. What is left at the end is
+	  a cheap rescale from the combined bounds and a parallel pairwise
+	  merge of the sorted key runs. If the faces come before the vertices in the file, normals
+	  and edges are computed after reading instead.
 	  =============================================== */
-void ply::loadGeometry() {
+bool ply::loadGeometry() {
 
-	/* You will implement this section of code
-		  1. Parse the header
+	/*    1.) Parse the header into elements and properties (plyformat.h)
 		  2.) Update any private or helper variables in the ply.h private section
 		  3.) allocate memory for the vertexList
-			  3a.) Populate vertices
+			  3a.) Populate vertices with the decoder for their layout
 		  4.) allocate memory for the faceList
-			  4a.) Populate faceList
+			  4a.) Populate faceList (polygons become triangle fans)
+		  Elements are read in the order the header lists them, and any
+		  element other than vertex and face is skipped.
 	*/
+	chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+	timing = loadTiming();
+	cleaned = cleanupStats();
+
+	// load the file, decompressing .ply.gz and .ply.zst as it is read;
+	// if the path is invalid, open reports and we leave the object empty
+	plyInput input;
+	if (!input.open(filePath)) {
+		return false;
+	}
 
+	plyReader reader(input.stream());
+	plyHeader header;
+	string error;
+	if (!reader.readHeader(header, error)) {
+		cout << "cannot parse " << filePath.c_str() << ": " << error << "\n";
+		return false;
+	}
+	// as before the header was parsed into a schema: every property line
+	// of the header less two, so x, y, z and the face list give 2
+	properties = header.propertyCount() - 2;
+
+	// the counts come from the file, so check them before trusting them
+	// with an allocation: records are numbered with ints, and a binary
+	// file must at least hold every record with its lists empty
+	for (int e = 0; e < (int)header.elements.size(); e++) {
+		if (header.elements[e].count > INT_MAX) {
+			cout << "cannot parse " << filePath.c_str() << ": too many " << header.elements[e].name << " records ("
+				<< header.elements[e].count << ")\n";
+			return false;
+		}
+	}
+	if (header.format != PLY_ASCII && input.getFileBytes() >= 0
+		&& header.minimumDataBytes() > (double)(input.getFileBytes() - header.headerBytes)) {
+		cout << "cannot parse " << filePath.c_str() << ": the header declares more records than the file holds\n";
+		return false;
+	}
 
-	ifstream myfile(filePath.c_str()); // load the file
-	if (myfile.is_open()) { // if the file is accessable
-		properties = -2; // set the properties because there are extras labeled
-
-		string line;
-		char * token_pointer;
-		char * lineCopy = new char[256];
-		int count;
-		bool reading_header = true;
-		// loop for reading the header 
-		while (reading_header && getline(myfile, line)) {
-
-			// get the first token in the line, this will determine which
-			// action to take. 
-			strcpy(lineCopy, line.c_str());
-			token_pointer = strtok(lineCopy, " \r");
-			// case when the element label is spotted:
-			if (strcmp(token_pointer, "element") == 0) {
-				token_pointer = strtok(NULL, " \r");
-
-				// When the vertex token is spotted read in the next token
-				// and use it to set the vertexCount and initialize vertexList
-				if (strcmp(token_pointer, "vertex") == 0) {
-					token_pointer = strtok(NULL, " \r");
-					vertexCount = atoi(token_pointer);
-					vertexList = new vertex*[vertexCount];
+	// work handed from the parser to the pool. deques, so the parser can
+	// add batches while tasks hold pointers to earlier ones
+	struct vertexBatch {
+		int start, count;
+		glm::vec3 sum, low, high;
+		double seconds;
+	};
+	struct faceBatch {
+		vector<face*> faces;
+		int firstFace;
+		vector<edgeKey> keys;
+		bool done;
+		double seconds;
+	};
+	deque<vertexBatch> vertexBatches;
+	deque<faceBatch> faceBatches;
+	// face batches appended to loadingFaces so far (in file order)
+	size_t published = 0;
+	taskGroup pipeline;
+
+	bool ok = true;
+	bool outOfMemory = false;
+	vertex** vertices = NULL;
+	int totalVertices = 0;
+	// vertices are allocated a batch at a time as they are read, so a
+	// count the file does not back costs no more than the data read;
+	// the pointer array grows by doubling, and the arrays it outgrows
+	// stay alive until the batch tasks that point into them are done
+	int allocatedVertices = 0;
+	int vertexCapacity = 0;
+	vector<vertex**> outgrown;
+	bool haveVertices = false;
+	bool haveFaces = false;
+	// every face batch went through the pipeline (vertices came first)
+	bool pipelined = true;
+	int nextFace = 0;
+	try {
+		for (int e = 0; ok && !cancelLoad && e < (int)header.elements.size(); e++) {
+			const plyElement& element = header.elements[e];
+
+			if (element.name == "vertex" && !haveVertices) {
+				haveVertices = true;
+				totalVertices = (int)element.count;
+
+				int batch = FIRST_LOAD_BATCH;
+				for (int start = 0; ok && !cancelLoad && start < totalVertices; start += batch, batch = min(2 * batch, MAX_LOAD_BATCH)) {
+					int count = min(batch, totalVertices - start);
+					if (start + count > vertexCapacity) {
+						int capacity = (int)min((long)totalVertices, max((long)start + count, 2 * (long)vertexCapacity));
+						vertex** grown = new vertex*[capacity];
+						copy(vertices, vertices + allocatedVertices, grown);
+						{
+							lock_guard<mutex> lock(loadLock);
+							loadingVertices = grown;
+						}
+						if (vertices != NULL) {
+							outgrown.push_back(vertices);
+						}
+						vertices = grown;
+						vertexCapacity = capacity;
+					}
+					for (; allocatedVertices < start + count; allocatedVertices++) {
+						vertices[allocatedVertices] = new vertex();
+					}
+					ok = readVertices(reader, header, element, vertices, start, count);
+					if (!ok) {
+						break;
+					}
+
+					vertexBatch work;
+					work.start = start;
+					work.count = count;
+					vertexBatches.push_back(work);
+					vertexBatch* stage = &vertexBatches.back();
+					pipeline.run([stage, vertices]() {
+						chrono::steady_clock::time_point stageStart = chrono::steady_clock::now();
+						glm::vec3 sum(0.0f), low(vertices[stage->start]->position), high(low);
+						for (int i = stage->start; i < stage->start + stage->count; i++) {
+							glm::vec3 position = vertices[i]->position;
+							sum = sum + position;
+							low = glm::min(low, position);
+							high = glm::max(high, position);
+						}
+						stage->sum = sum;
+						stage->low = low;
+						stage->high = high;
+						stage->seconds = chrono::duration<double>(chrono::steady_clock::now() - stageStart).count();
+					});
+
+					lock_guard<mutex> lock(loadLock);
+					if (start == 0) {
+						// the preview is normalized from the first batch only
+						previewCenter = glm::vec3(0.0f);
+						for (int i = 0; i < count; i++) {
+							previewCenter = previewCenter + vertices[i]->position;
+						}
+						previewCenter = previewCenter / (float)max(count, 1);
+						float extent = 0.0f;
+						for (int i = 0; i < count; i++) {
+							glm::vec3 offset = glm::abs(vertices[i]->position - previewCenter);
+							extent = fmax(extent, fmax(offset.x, fmax(offset.y, offset.z)));
+						}
+						previewScale = extent > 0.0f ? 0.5f / extent : 1.0f;
+					}
+					loadedVertices = start + count;
 				}
-
-				// When the face label is spotted read in the next token and 
-				// use it to set the faceCount and initialize faceList.
-				if (strcmp(token_pointer, "face") == 0) {
-					token_pointer = strtok(NULL, " \r");
-					faceCount = atoi(token_pointer);
-					faceList = new face*[faceCount];
+			}
+			else if (element.name == "face" && !haveFaces) {
+				haveFaces = true;
+				long total = element.count;
+
+				long batch = FIRST_LOAD_BATCH;
+				for (long start = 0; ok && !cancelLoad && start < total; start += batch, batch = min(2 * batch, (long)MAX_LOAD_BATCH)) {
+					long count = min(batch, total - start);
+					vector<face*> faces;
+					ok = readFaces(reader, header, element, faces, count);
+
+					bool vertsReady = haveVertices && loadedVertices == totalVertices;
+					pipelined = pipelined && vertsReady;
+					faceBatch* stage;
+					{
+						lock_guard<mutex> lock(loadLock);
+						faceBatches.push_back(faceBatch());
+						stage = &faceBatches.back();
+						stage->faces.swap(faces);
+						stage->firstFace = nextFace;
+						stage->done = false;
+						stage->seconds = 0.0;
+						nextFace += (int)stage->faces.size();
+					}
+
+					pipeline.run([this, stage, vertices, totalVertices, vertsReady, &faceBatches, &published]() {
+						chrono::steady_clock::time_point stageStart = chrono::steady_clock::now();
+						if (vertsReady) {
+							int count = (int)stage->faces.size();
+							computeFaceNormals(vertices, totalVertices, stage->faces.data(), 0, count, false);
+							stage->keys.resize(3 * (size_t)count);
+							size_t written = 0;
+							for (int i = 0; i < count; i++) {
+								written += writeEdgeKeys(stage->faces[i], stage->firstFace + i, totalVertices, &stage->keys[written]);
+							}
+							stage->keys.resize(written);
+							sort(stage->keys.begin(), stage->keys.end(), edgeKeyLess);
+						}
+						stage->seconds = chrono::duration<double>(chrono::steady_clock::now() - stageStart).count();
+
+						// the preview gets the batches in file order
+						lock_guard<mutex> lock(loadLock);
+						stage->done = true;
+						while (published < faceBatches.size() && faceBatches[published].done) {
+							vector<face*>& ready = faceBatches[published].faces;
+							loadingFaces.insert(loadingFaces.end(), ready.begin(), ready.end());
+							vector<face*>().swap(ready);
+							published++;
+						}
+					});
 				}
 			}
-			// if property label increment the number of properties.
-			if (strcmp(token_pointer, "property") == 0) { properties++; }
-			// if end_header break the header loop and move to reading vertices.
-			if (strcmp(token_pointer, "end_header") == 0) { reading_header = false; }
+			else {
+				ok = skipElement(reader, header, element);
+			}
 		}
-
-		// Read in exactly vertexCount number of lines after reading the header
-		// and set the appropriate vertex in the vertexList.
-		for (int i = 0; i < vertexCount; i++) {
-			vertexList[i] = new vertex();
-
-			getline(myfile, line);
-			strcpy(lineCopy, line.c_str());
-
-			// depending on how many properties there are set that number of 
-			// elements (x, y, z, confidence, intensity, r, g, b) (max 7) with
-			// the input given
-			if (properties >= 0) {
-				vertexList[i]->position.x = atof(strtok(lineCopy, " \r"));
+	}
+	catch (const bad_alloc&) {
+		// what was read so far is freed with the rest below
+		ok = false;
+		outOfMemory = true;
+	}
+	input.close();
+	timing.parse = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+	try {
+		pipeline.wait();
+	}
+	catch (const bad_alloc&) {
+		ok = false;
+		outOfMemory = true;
+	}
+	for (size_t i = 0; i < outgrown.size(); i++) {
+		delete[] outgrown[i];
+	}
+	for (size_t b = 0; b < vertexBatches.size(); b++) {
+		timing.bounds += vertexBatches[b].seconds;
+	}
+	for (size_t b = 0; b < faceBatches.size(); b++) {
+		timing.faces += faceBatches[b].seconds;
+	}
+	timing.pipeline = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+
+	// which final face each face read becomes (-1 if dropped)
+	vector<int> remap;
+	{
+		// renderProgress waits while the geometry changes hands and is
+		// rescaled; after this the object draws like any loaded mesh
+		lock_guard<mutex> lock(loadLock);
+		vector<face*> faces;
+		faces.swap(loadingFaces);
+		loadingVertices = NULL;
+		loadedVertices = 0;
+
+		// drop faces that point outside the vertex list rather than crash later
+		int kept = 0;
+		for (size_t i = 0; i < faces.size(); i++) {
+			const int* corners = faces[i]->vertexList;
+			bool valid = true;
+			for (int j = 0; j < 3; j++) {
+				valid = valid && corners[j] >= 0 && corners[j] < totalVertices;
 			}
-			if (properties >= 1) {
-				vertexList[i]->position.y = atof(strtok(NULL, " \r"));
+			if (valid) {
+				faces[kept++] = faces[i];
 			}
-			if (properties >= 2) {
-				vertexList[i]->position.z = atof(strtok(NULL, " \r"));
+			else {
+				if (remap.empty()) {
+					remap.resize(faces.size());
+					for (size_t k = 0; k < i; k++) {
+						remap[k] = (int)k;
+					}
+				}
+				delete faces[i];
+			}
+			if (!remap.empty()) {
+				remap[i] = valid ? kept - 1 : -1;
 			}
 		}
-
-		// Read in the faces (exactly faceCount number of lines) and set the 
-		// appropriate face in the faceList
+		vertexList = vertices;
+		// all of them unless the load stopped early
+		vertexCount = allocatedVertices;
+		faceCount = kept;
+		faceList = new face*[faceCount];
 		for (int i = 0; i < faceCount; i++) {
-			getline(myfile, line);
+			faceList[i] = faces[i];
+		}
+
+		if (!ok || cancelLoad) {
+			if (outOfMemory) {
+				cout << "cannot load " << filePath.c_str() << ": out of memory\n";
+			}
+			else if (!ok) {
+				cout << "cannot parse " << filePath.c_str() << ": file ends early\n";
+			}
+			deconstruct();
+			return false;
+		}
+
+		chrono::steady_clock::time_point rescaleStart = chrono::steady_clock::now();
+		glm::vec3 sum(0.0f), low(0.0f), high(0.0f);
+		for (size_t b = 0; b < vertexBatches.size(); b++) {
+			sum = sum + vertexBatches[b].sum;
+			low = b == 0 ? vertexBatches[b].low : glm::min(low, vertexBatches[b].low);
+			high = b == 0 ? vertexBatches[b].high : glm::max(high, vertexBatches[b].high);
+		}
+		scaleAndCenter(sum, low, high);
+		// the pipeline's normals and edge keys are stale once anything
+		// is welded or dropped
+		if (getMeshCleanup()) {
+			chrono::steady_clock::time_point cleanupStart = chrono::steady_clock::now();
+			if (cleanup(getMeshWeldTolerance())) {
+				pipelined = false;
+			}
+			timing.cleanup = chrono::duration<double>(chrono::steady_clock::now() - cleanupStart).count();
+		}
+		if (!pipelined) {
+			computeFaceNormals(vertexList, vertexCount, faceList, 0, faceCount, true);
+		}
+		timing.rescale = chrono::duration<double>(chrono::steady_clock::now() - rescaleStart).count() - timing.cleanup;
+	}
 
-			strcpy(lineCopy, line.c_str());
-			count = atoi(strtok(lineCopy, " \r"));
+	// leave out what would take the mesh over the memory budget
+	size_t budget = getMeshMemoryBudget();
+	if (budget > 0) {
+		size_t core = getMemoryBytes();
+		// a closed manifold mesh has 3/2 edges per face
+		size_t edgeBytes = (size_t)faceCount * 3 / 2 * (sizeof(edge) + sizeof(edge*));
+		size_t bvhBytes = bvh::estimateMemoryBytes(faceCount);
+		bvhEnabled = core + edgeBytes + bvhBytes <= budget;
+		edgesEnabled = core + edgeBytes <= budget;
+	}
 
-			faceList[i] = new face();
-			//faceList[i]->vertexCount = count; // number of vertices stored 
-			//faceList[i]->vertexList = new int[count]; // initialize the vertices
+	// the BVH and the edge list only read the geometry, so build both at once
+	taskGroup group;
+	if (bvhEnabled) {
+		group.run([this]() {
+			chrono::steady_clock::time_point bvhStart = chrono::steady_clock::now();
+			faceBVH->build(this);
+			timing.bvh = chrono::duration<double>(chrono::steady_clock::now() - bvhStart).count();
+		});
+	}
+	chrono::steady_clock::time_point edgeStart = chrono::steady_clock::now();
+	if (edgesEnabled && pipelined) {
+		// the batches' sorted runs side by side, then merged into one.
+		// remap keeps the order of the faces it keeps, so the runs stay
+		// sorted
+		vector<int> bounds(faceBatches.size() + 1, 0);
+		for (size_t b = 0; b < faceBatches.size(); b++) {
+			bounds[b + 1] = bounds[b] + (int)faceBatches[b].keys.size();
+		}
+		vector<edgeKey> keys(bounds.back());
+		parallelFor(0, (int)faceBatches.size(), 1, [&](int start, int end) {
+			for (int b = start; b < end; b++) {
+				vector<edgeKey>& run = faceBatches[b].keys;
+				for (size_t k = 0; k < run.size(); k++) {
+					keys[bounds[b] + k] = run[k];
+					if (!remap.empty()) {
+						keys[bounds[b] + k].face = remap[run[k].face];
+					}
+				}
+				vector<edgeKey>().swap(run);
+			}
+		});
+		parallelMergeRanges(keys.data(), bounds, edgeKeyLess);
+		edgesFromKeys(keys);
+	}
+	else if (edgesEnabled) {
+		findEdges();
+	}
+	timing.edges = chrono::duration<double>(chrono::steady_clock::now() - edgeStart).count();
+	if (edgesEnabled) {
+		chrono::steady_clock::time_point featureStart = chrono::steady_clock::now();
+		findFeatureEdges();
+		timing.features = chrono::duration<double>(chrono::steady_clock::now() - featureStart).count();
+	}
+	group.wait();
+	timing.total = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+	return true;
+};
 
-			// set the vertices from the input, reading only the number of 
-			// vertices that are specified
-			for (int j = 0; j < 3; j++) {
-				faceList[i]->vertexList[j] = atoi(strtok(NULL, " \r"));
+void ply::computeFaceNormals(vertex** vertices, int count, face** faces, int begin, int end, bool parallel) {
+	auto body = [=](int start, int end) {
+		for (int i = start; i < end; i++) {
+			const int* corners = faces[i]->vertexList;
+			// faces pointing outside the vertex list are dropped later
+			if (corners[0] < 0 || corners[0] >= count || corners[1] < 0 || corners[1] >= count
+				|| corners[2] < 0 || corners[2] >= count) {
+				continue;
 			}
+			glm::vec3 v0Pos = vertices[corners[0]]->position;
+			glm::vec3 v1Pos = vertices[corners[1]]->position;
+			glm::vec3 v2Pos = vertices[corners[2]]->position;
+
+			glm::vec3 v1v0 = glm::normalize(v1Pos - v0Pos);
+			glm::vec3 v2v0 = glm::normalize(v2Pos - v0Pos);
 
+			glm::vec3 normal = glm::normalize(glm::cross(v1v0, v2v0));
+
+			faces[i]->faceNormal = normal;
 		}
-		delete(lineCopy);
+	};
+	if (parallel) {
+		parallelFor(begin, end, 4096, body);
 	}
-	// if the path is invalid, report then exit.
 	else {
-		cout << "cannot open file " << filePath.c_str() << "\n";
-		exit(1);
+		body(begin, end);
 	}
+}
 
-	myfile.close();
-	scaleAndCenter();
-	computeFaceNormals();
-	findEdges();
-};
+/*  ===============================================
+	  Desc: Welds vertices closer than tolerance, then drops the faces
+	  left degenerate (two corners on one vertex, or no area) and every
+	  face that repeats the three vertices of an earlier one, in either
+	  winding. Counts go to cleaned.
+	  Vertices are hashed into a grid of cells twice the tolerance wide,
+	  so each is compared only with the vertices of the 8 cells around
+	  the cell corner nearest to it (see weldCell). A vertex joins the
+	  lowest-numbered vertex within tolerance, following chains so a
+	  cluster ends on one vertex, whose position it takes.
+	  Precondition: every face corner is a valid vertex index
+	  Postcondition: vertexList and faceList are compacted and the face
+	  corners renumbered; returns whether anything was removed
+	=============================================== */
+bool ply::cleanup(float tolerance) {
+	cleaned = cleanupStats();
+	cleaned.applied = true;
+
+	// sorted by cell hash, and by index within a cell
+	vector<weldKey> keys(vertexCount);
+	parallelFor(0, vertexCount, 8192, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			long long cell[3];
+			int side[3];
+			weldCell(vertexList[i]->position, tolerance, cell, side);
+			keys[i].cell = cellHash(cell[0], cell[1], cell[2]);
+			keys[i].vertex = i;
+		}
+	});
+	if (!keys.empty()) {
+		parallelSort(&keys[0], &keys[0] + keys.size(), weldKeyLess);
+	}
 
-void ply::computeFaceNormals() {
-	int i;
-	for (i = 0; i < faceCount; i++) {
-		glm::vec3 v0Pos = vertexList[faceList[i]->vertexList[0]]->position;
-		glm::vec3 v1Pos = vertexList[faceList[i]->vertexList[1]]->position;
-		glm::vec3 v2Pos = vertexList[faceList[i]->vertexList[2]]->position;
+	// open addressing from a cell hash to the first of its keys
+	size_t tableSize = 1;
+	while (tableSize < 2 * keys.size()) {
+		tableSize <<= 1;
+	}
+	size_t mask = tableSize - 1;
+	vector<int> table(tableSize, -1);
+	for (size_t k = 0; k < keys.size(); k++) {
+		if (k > 0 && keys[k].cell == keys[k - 1].cell) {
+			continue;
+		}
+		size_t slot = (size_t)keys[k].cell & mask;
+		while (table[slot] >= 0) {
+			slot = (slot + 1) & mask;
+		}
+		table[slot] = (int)k;
+	}
 
-		glm::vec3 v1v0 = glm::normalize(v1Pos - v0Pos);
-		glm::vec3 v2v0 = glm::normalize(v2Pos - v0Pos);
+	// target[i]: the lowest vertex within tolerance of i (i itself if none)
+	float limit = tolerance * tolerance;
+	vector<int> target(vertexCount);
+	parallelFor(0, vertexCount, 4096, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			glm::vec3 position = vertexList[i]->position;
+			long long cell[3];
+			int side[3];
+			weldCell(position, tolerance, cell, side);
+			int best = i;
+			for (int n = 0; n < 8; n++) {
+				// with no tolerance every neighbour is the cell itself
+				if (tolerance <= 0.0f && n > 0) {
+					break;
+				}
+				unsigned long long hash = cellHash(cell[0] + (n & 1 ? side[0] : 0),
+					cell[1] + (n & 2 ? side[1] : 0), cell[2] + (n & 4 ? side[2] : 0));
+				size_t slot = (size_t)hash & mask;
+				while (table[slot] >= 0 && keys[table[slot]].cell != hash) {
+					slot = (slot + 1) & mask;
+				}
+				if (table[slot] < 0) {
+					continue;
+				}
+				// other cells with the same hash fail the distance test
+				for (size_t k = table[slot]; k < keys.size() && keys[k].cell == hash && keys[k].vertex < best; k++) {
+					glm::vec3 offset = vertexList[keys[k].vertex]->position - position;
+					if (glm::dot(offset, offset) <= limit) {
+						best = keys[k].vertex;
+						break;
+					}
+				}
+			}
+			target[i] = best;
+		}
+	});
+
+	// a target is always lower, so it is resolved before the vertices
+	// that point to it
+	vector<int> index(vertexCount);
+	int kept = 0;
+	for (int i = 0; i < vertexCount; i++) {
+		if (target[i] == i) {
+			index[i] = kept++;
+		}
+		else {
+			target[i] = target[target[i]];
+			index[i] = index[target[i]];
+		}
+	}
+	cleaned.weldedVertices = vertexCount - kept;
+	if (kept < vertexCount) {
+		vertex** vertices = new vertex*[kept];
+		for (int i = 0; i < vertexCount; i++) {
+			if (target[i] == i) {
+				vertices[index[i]] = vertexList[i];
+			}
+			else {
+				delete vertexList[i];
+			}
+		}
+		delete[] vertexList;
+		vertexList = vertices;
+		vertexCount = kept;
+	}
 
-		glm::vec3 normal = glm::normalize(glm::cross(v1v0, v2v0));
+	// 1 for a degenerate face, 2 for a duplicate
+	vector<unsigned char> drop(faceCount, 0);
+	vector<faceKey> faceKeys(faceCount);
+	parallelFor(0, faceCount, 4096, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			int* corners = faceList[i]->vertexList;
+			for (int j = 0; j < 3; j++) {
+				corners[j] = index[corners[j]];
+			}
+			if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) {
+				drop[i] = 1;
+			}
+			else {
+				glm::vec3 v0Pos = vertexList[corners[0]]->position;
+				glm::vec3 v1v0 = vertexList[corners[1]]->position - v0Pos;
+				glm::vec3 v2v0 = vertexList[corners[2]]->position - v0Pos;
+				glm::vec3 normal = glm::cross(v1v0, v2v0);
+				// no area, up to float rounding, relative to the edges
+				// (the negated test also catches NaN positions)
+				float scale = DEGENERATE_SINE * glm::dot(v1v0, v1v0) * glm::dot(v2v0, v2v0);
+				if (!(glm::dot(normal, normal) > DEGENERATE_SINE * scale)) {
+					drop[i] = 1;
+				}
+			}
+			faceKeys[i].corners[0] = min(corners[0], min(corners[1], corners[2]));
+			faceKeys[i].corners[2] = max(corners[0], max(corners[1], corners[2]));
+			faceKeys[i].corners[1] = corners[0] + corners[1] + corners[2] - faceKeys[i].corners[0] - faceKeys[i].corners[2];
+			faceKeys[i].face = i;
+		}
+	});
+	if (!faceKeys.empty()) {
+		parallelSort(&faceKeys[0], &faceKeys[0] + faceKeys.size(), faceKeyLess);
+	}
+	// a degenerate face never shares a key with a valid one, so each run
+	// of equal keys is all one or the other; the first face of a run stays
+	for (size_t k = 1; k < faceKeys.size(); k++) {
+		const faceKey& previous = faceKeys[k - 1];
+		const faceKey& key = faceKeys[k];
+		if (key.corners[0] == previous.corners[0] && key.corners[1] == previous.corners[1]
+			&& key.corners[2] == previous.corners[2] && drop[key.face] == 0) {
+			drop[key.face] = 2;
+		}
+	}
 
-		faceList[i]->faceNormal = normal;
+	for (int i = 0; i < faceCount; i++) {
+		cleaned.degenerateFaces += drop[i] == 1;
+		cleaned.duplicateFaces += drop[i] == 2;
+	}
+	int keptFaces = 0;
+	face** faces = new face*[faceCount - cleaned.degenerateFaces - cleaned.duplicateFaces];
+	for (int i = 0; i < faceCount; i++) {
+		if (drop[i] == 0) {
+			faces[keptFaces++] = faceList[i];
+		}
+		else {
+			delete faceList[i];
+		}
 	}
+	delete[] faceList;
+	faceList = faces;
+	faceCount = keptFaces;
+
+	return cleaned.weldedVertices > 0 || cleaned.degenerateFaces > 0 || cleaned.duplicateFaces > 0;
 }
 
 /*  ===============================================
 Desc: Moves all the geometry so that the object is centered at 0, 0, 0 and scaled to be between 0.5 and -0.5
-Precondition: after all the vetices and faces have been loaded in
+Precondition: after all the vetices and faces have been loaded in, and
+sum, low and high are the sum and bounds of every vertex position
 Postcondition: points have reasonable values
 =============================================== */
-void ply::scaleAndCenter() {
-    glm::vec3 avrg(0.0f, 0.0f, 0.0f);
-    float max = 0.0;
-    int i, j;
-
-    //loop through each vertex in the given image
-    for (i = 0; i < vertexCount; i++) {
-        // obtain the total for each property of the vertex
-        avrg = avrg + vertexList[i]->position;
+void ply::scaleAndCenter(glm::vec3 sum, glm::vec3 low, glm::vec3 high) {
+    if (vertexCount == 0) {
+        return;
     }
-    
     // compute the average for each property
-    avrg = avrg / (float)vertexCount;
-    
-    // obtain the max dimension to find the furthest point from 0,0
-    for (i = 0; i < vertexCount; i++) {
-        vertexList[i]->position = vertexList[i]->position - avrg;
-        for (j = 0; j < 3; j++) {
-            if (max < fabs(vertexList[i]->position[j]))
-            max = fabs(vertexList[i]->position[j]);
-        }
-    }
+    glm::vec3 avrg = sum / (float)vertexCount;
 
+    // the furthest point from the average along any axis is at one end of
+    // the bounding box, so max comes from the box instead of another pass
+    float max = 0.0f;
+    for (int j = 0; j < 3; j++) {
+        max = fmax(max, fmax(high[j] - avrg[j], avrg[j] - low[j]));
+    }
     max *= 2.0f;
-
-    // center and scale each vertex 
-    for (i = 0; i < vertexCount; i++) {
-        vertexList[i]->position = (vertexList[i]->position) / max;
+    if (max == 0.0f) {
+        max = 1.0f;
     }
+    originalCenter = avrg;
+    originalScale = max;
+
+    // center and scale each vertex
+    parallelFor(0, vertexCount, 8192, [&](int start, int end) {
+        for (int i = start; i < end; i++) {
+            vertexList[i]->position = (vertexList[i]->position - avrg) / max;
+        }
+    });
 }
 
 /*  ===============================================
@@ -262,11 +1018,17 @@ void ply::scaleAndCenter() {
 	  Error Condition: If we haven't allocated memory for our
 	  faceList or vertexList then do not attempt to render.
 	=============================================== */
-void ply::render(int frontvBackFace) {
+void ply::render(int frontvBackFace, bool occlusion) {
 	int i;
 	if (vertexList == NULL || faceList == NULL) {
 		return;
 	}
+	occlusion = occlusion && (int)ambientOcclusion.size() == vertexCount;
+	// the colour set by the caller, scaled per vertex below
+	GLfloat color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (occlusion) {
+		glGetFloatv(GL_CURRENT_COLOR, color);
+	}
 
 	glPushMatrix();
 	// For each of our faces
@@ -277,24 +1039,69 @@ void ply::render(int frontvBackFace) {
 
 		glNormal3fv(glm::value_ptr(faceNormal));
 
+		glm::vec3 faceColor(color[0], color[1], color[2]);
 		if (frontvBackFace == 1) {
 			if (isFrontFace == 1) {
-				glColor3f(0.0f, 1.0f, 0.0f);
+				faceColor = glm::vec3(0.0f, 1.0f, 0.0f);
 			}
 			else {
-				glColor3f(1.0f, 0.0f, 0.0f);
+				faceColor = glm::vec3(1.0f, 0.0f, 0.0f);
 			}
+			glColor3fv(glm::value_ptr(faceColor));
 		}
 
 		for (int j = 0; j < 3; j++) {
 			// Get each vertices x,y,z and draw them
 			int index = faceList[i]->vertexList[j];
+			if (occlusion) {
+				glColor3fv(glm::value_ptr(faceColor * ambientOcclusion[index]));
+			}
 			glVertex3fv(glm::value_ptr(vertexList[index]->position));
 		}
 	}
 	glEnd();
 }
 
+void ply::renderColored(const vector<glm::vec3>& colors) {
+	if (vertexList == NULL || faceList == NULL || (int)colors.size() != vertexCount) {
+		return;
+	}
+
+	glBegin(GL_TRIANGLES);
+	for (int i = 0; i < faceCount; i++) {
+		glNormal3fv(glm::value_ptr(faceList[i]->faceNormal));
+		for (int j = 0; j < 3; j++) {
+			int index = faceList[i]->vertexList[j];
+			glColor3fv(glm::value_ptr(colors[index]));
+			glVertex3fv(glm::value_ptr(vertexList[index]->position));
+		}
+	}
+	glEnd();
+}
+
+/*  ===============================================
+	  Desc: Draws the filled mesh through a display list, so that drawing
+	  many instances of it only replays the list instead of resending
+	  every vertex through glBegin/glEnd
+	  Precondition: a GL context is current
+	=============================================== */
+void ply::renderCached() {
+	if (vertexList == NULL || faceList == NULL) {
+		return;
+	}
+
+	if (displayList == 0) {
+		displayList = glGenLists(1);
+		// one normal and three positions per face
+		displayListBytes = (size_t)faceCount * 4 * sizeof(glm::vec3);
+		glNewList(displayList, GL_COMPILE);
+		render();
+		glPopMatrix();
+		glEndList();
+	}
+	glCallList(displayList);
+}
+
 void ply::renderNormal() {
 	int i;
 	glColor3f(1.0f, 1.0f, 0.0f);
@@ -331,161 +1138,437 @@ void ply::computeFrontFace(glm::vec3 lookVector) {
 	}
 }
 
+void ply::computeFrontFace(glm::vec3 lookVector, vector<unsigned char>& frontFaces) {
+	frontFaces.resize(faceCount);
+	for (int i = 0; i < faceCount; i++) {
+		frontFaces[i] = glm::dot(lookVector, faceList[i]->faceNormal) < 0 ? 1 : 0;
+	}
+}
+
 
 //loads data structures so edges are known
+/*  ===============================================
+	  Desc: Fills edgeList with every edge shared by two faces
+	  Every face emits a key for each of its three edges (the two vertex
+	  indices, smallest first). After sorting the keys, faces that share an
+	  edge sit next to each other, so one scan finds all shared edges in
+	  O(F log F) instead of comparing every pair of faces.
+	  An edge used by more than two faces (non-manifold) keeps the first two.
+	=============================================== */
 void ply::findEdges() {
-	//edges, if you want to use this data structure
-	//TODO add all the edges to the edgeList and make sure they have both faces
-	face *face1;
-	face *face2;
-    edge *old_edge;
-    bool edge_already_exists;
-    vector<edge*> edge_vector;
-
-	// create a loop to go through each face in faceList
-	for (int i = 0; i < faceCount; i++) {
-		face1 = faceList[i];
-
-		for (int j = i+1; j < faceCount-1; j++) {
-			face2 = faceList[j];
-
-			// find -> beginning of array, end of array, int to find, returns idx of int to find if found
-			bool share0, share1, share2;
-			share0 = find(begin(face1->vertexList), end(face1->vertexList), face2->vertexList[0]) != end(face1->vertexList);
-			share1 = find(begin(face1->vertexList), end(face1->vertexList), face2->vertexList[1]) != end(face1->vertexList);
-			share2 = find(begin(face1->vertexList), end(face1->vertexList), face2->vertexList[2]) != end(face1->vertexList);
-
-			// faces share edge composed of face2->vertexList[0] and face2->vertexList[1]
-			if (share0 && share1) {
-				edge *new_edge = new edge();
-				new_edge->vertices[0] = face2->vertexList[0];
-				new_edge->vertices[1] = face2->vertexList[1];
-				new_edge->faces[0] = i; // index of face1
-				new_edge->faces[1] = j; // index of face2
-				
-				// check that edge does not exist in edgeList
-                edge_already_exists = false;
-				for (int k = 0; k < edgeCount; k++){
-                    old_edge = edge_vector[k];
-
-                    // call edge class equality function
-                    if (old_edge->equals(*new_edge)) {
-                        edge_already_exists = true;
-                        break;
-                    }
-				}
+	// every face in faceList is valid, so face i has keys 3i .. 3i + 2
+	vector<edgeKey> keys((size_t)faceCount * 3);
+	parallelFor(0, faceCount, 4096, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			writeEdgeKeys(faceList[i], i, vertexCount, &keys[(size_t)i * 3]);
+		}
+	});
 
-                if (edge_already_exists) {delete new_edge;}
-                else {
-                    edge_vector.push_back(new_edge);
-                    edgeCount++;
-                }
+	if (!keys.empty()) {
+		parallelSort(&keys[0], &keys[0] + keys.size(), edgeKeyLess);
+	}
+	edgesFromKeys(keys);
+}
+
+/*  ===============================================
+	  Desc: Builds edgeList from edge keys sorted by vertex pair and
+	  face. Every group of equal keys is an edge, between the first two
+	  faces of the group.
+	=============================================== */
+void ply::edgesFromKeys(const vector<edgeKey>& keys) {
+	vector<edge*> edges;
+	const edgeKey* previous = NULL;
+	bool paired = false;
+	for (size_t k = 0; k < keys.size(); k++) {
+		const edgeKey& key = keys[k];
+		if (previous != NULL && previous->vertices == key.vertices) {
+			if (!paired) {
+				edge* new_edge = new edge();
+				new_edge->vertices[0] = faceList[previous->face]->vertexList[previous->corner];
+				new_edge->vertices[1] = faceList[previous->face]->vertexList[(previous->corner + 1) % 3];
+				new_edge->faces[0] = previous->face;
+				new_edge->faces[1] = key.face;
+				edges.push_back(new_edge);
+				paired = true;
 			}
+		}
+		else {
+			paired = false;
+		}
+		previous = &key;
+	}
 
-            // faces share edge composed of face2->vertexList[0] and face2->vertexList[2]
-			if (share0 && share2) {
-				edge *new_edge = new edge();
-				new_edge->vertices[0] = face2->vertexList[0];
-				new_edge->vertices[1] = face2->vertexList[2];
-				new_edge->faces[0] = i; // index of face1
-				new_edge->faces[1] = j; // index of face2
-				
-				// check that edge does not exist in edgeList
-                edge_already_exists = false;
-				for (int k = 0; k < edgeCount; k++){
-                    old_edge = edge_vector[k];
-
-                    // call edge class equality function
-                    if (old_edge->equals(*new_edge)) {
-                        edge_already_exists = true;
-                        break;
-                    }
-				}
+	edgeCount = (int)edges.size();
+	edgeList = new edge*[edgeCount];
+	for (int i = 0; i < edgeCount; i++) {
+		edgeList[i] = edges[i];
+	}
+}
 
-                if (edge_already_exists) {delete new_edge;}
-                else {
-                    edge_vector.push_back(new_edge);
-                    edgeCount++;
-                }
-			}
 
-            // faces share edge composed of face2->vertexList[1] and face2->vertexList[2]
-			if (share1 && share2) {
-				edge *new_edge = new edge();
-				new_edge->vertices[0] = face2->vertexList[1];
-				new_edge->vertices[1] = face2->vertexList[2];
-				new_edge->faces[0] = i; // index of face1
-				new_edge->faces[1] = j; // index of face2
-				
-				// check that edge does not exist in edgeList
-                edge_already_exists = false;
-				for (int k = 0; k < edgeCount; k++){
-                    old_edge = edge_vector[k];
-
-                    // call edge class equality function
-                    if (old_edge->equals(*new_edge)) {
-                        edge_already_exists = true;
-                        break;
-                    }
-				}
+/*  ===============================================
+	  Desc: Fills featureEdges with every edge, sharpest first, and
+	  featureAngles with the angle between the normals of its two faces
+	  Edges next to a face with no normal (a degenerate face the
+	  load kept) count as flat.
+	  Precondition: edges and face normals are known
+	=============================================== */
+void ply::findFeatureEdges() {
+	// sorting the angle with the edge keeps the pairs together
+	vector<pair<float, int> > order(edgeCount);
+	parallelFor(0, edgeCount, 8192, [&](int start, int end) {
+		for (int i = start; i < end; i++) {
+			const edge* e = edgeList[i];
+			float cosine = glm::dot(faceList[e->faces[0]]->faceNormal, faceList[e->faces[1]]->faceNormal);
+			float angle = glm::degrees(acos(fmax(-1.0f, fmin(1.0f, cosine))));
+			order[i] = make_pair(isnan(angle) ? 0.0f : angle, i);
+		}
+	});
+	if (!order.empty()) {
+		parallelSort(&order[0], &order[0] + order.size(), [](const pair<float, int>& a, const pair<float, int>& b) {
+			return a.first > b.first || (a.first == b.first && a.second < b.second);
+		});
+	}
 
-                if (edge_already_exists) {delete new_edge;}
-                else {
-                    edge_vector.push_back(new_edge);
-                    edgeCount++;
-                }
+	featureEdges.resize(edgeCount);
+	featureAngles.resize(edgeCount);
+	for (int i = 0; i < edgeCount; i++) {
+		featureAngles[i] = order[i].first;
+		featureEdges[i] = order[i].second;
+	}
+}
+
+int ply::getFeatureEdgeCount(float minAngle) {
+	// the first angle below minAngle ends the prefix
+	return (int)(upper_bound(featureAngles.begin(), featureAngles.end(), minAngle, greater<float>()) - featureAngles.begin());
+}
+
+/*  ===============================================
+	  Desc: Draws the edges of minAngle degrees or more
+	  The lists are compiled the first time, from the sorted edges, so
+	  after that a frame costs at most FEATURE_LISTS glCallList calls
+	  however the threshold moves. Edges under MIN_FEATURE_ANGLE degrees
+	  are never drawn and get no list.
+	  Precondition: a GL context is current
+	=============================================== */
+void ply::renderFeatureEdges(int minAngle) {
+	if (featureEdges.empty() || minAngle >= MIN_FEATURE_ANGLE + FEATURE_LISTS) {
+		return;
+	}
+
+	if (featureLists == 0) {
+		featureLists = glGenLists(FEATURE_LISTS);
+		// two positions per edge
+		featureListBytes = (size_t)getFeatureEdgeCount((float)MIN_FEATURE_ANGLE) * 2 * sizeof(glm::vec3);
+		// the edges are sharpest first, so each list takes the run of
+		// edges before the next lower whole degree
+		int next = 0;
+		for (int list = FEATURE_LISTS - 1; list >= 0; list--) {
+			int end = getFeatureEdgeCount((float)(MIN_FEATURE_ANGLE + list));
+			glNewList(featureLists + list, GL_COMPILE);
+			glBegin(GL_LINES);
+			for (; next < end; next++) {
+				const edge* e = edgeList[featureEdges[next]];
+				glm::vec3 a = vertexList[e->vertices[0]]->position;
+				glm::vec3 b = vertexList[e->vertices[1]]->position;
+				glVertex3f(a.x, a.y, a.z);
+				glVertex3f(b.x, b.y, b.z);
 			}
+			glEnd();
+			glEndList();
 		}
 	}
-    
-    // populate edgeList with all edges
-    edgeList = new edge*[edgeCount];
-    for(int i = 0; i < edgeCount; i++){
-        edgeList[i] = edge_vector[i];
-    }
-}
 
+	// the lists are consecutive, so one call replays every list from
+	// the threshold up
+	int first = max(minAngle, MIN_FEATURE_ANGLE) - MIN_FEATURE_ANGLE;
+	vector<GLuint> lists(FEATURE_LISTS - first);
+	for (int i = 0; i < (int)lists.size(); i++) {
+		lists[i] = featureLists + first + i;
+	}
+	glCallLists((GLsizei)lists.size(), GL_UNSIGNED_INT, &lists[0]);
+}
 
 /* Desc: Renders the silhouette
  * Precondition: Edges are known
  */
 void ply::renderSilhouette(glm::vec3 lookVector) {
-	//TODO Iterate through the edgeList, and if you want to draw an edge,
-	//call glVertex3f once for each vertex in that edge.  
+	// the silhouette edges are drawn as line strips along each polyline,
+	// so a vertex shared by two silhouette edges is only sent once
+	getSilhouettePolylines(silhouettePolylines);
 	glPushMatrix();
-	glBegin(GL_LINES);
+	renderPolylines(silhouettePolylines);
+	glPopMatrix();
+}
 
-    for (int i = 0; i < edgeCount; i++) {
-        // if frontFace values are not equal, they are either [1,0] or [0,1]
-        // in either case, one face is front-facing and the other is back-facing, so we draw
-        
-        int face1_idx = edgeList[i]->faces[0];
-        int face2_idx = edgeList[i]->faces[1];
+/* Desc: Renders the silhouette using front-face flags computed by
+ * computeFrontFace(lookVector, frontFaces) rather than the ones in faceList
+ * Precondition: Edges are known, frontFaces has one entry per face
+ */
+void ply::renderSilhouette(const vector<unsigned char>& frontFaces) {
+	getSilhouettePolylines(frontFaces, silhouettePolylines);
+	renderPolylines(silhouettePolylines);
+}
 
-        int face1_front = faceList[face1_idx]->frontFace;
-        int face2_front = faceList[face2_idx]->frontFace;
+void ply::renderSilhouetteEdges(const vector<int>& edges) {
+	chainEdges(edges, silhouettePolylines);
+	renderPolylines(silhouettePolylines);
+}
 
-        if (face1_front != face2_front) {
-            vertex *vertex1 = vertexList[edgeList[i]->vertices[0]];
-            vertex *vertex2 = vertexList[edgeList[i]->vertices[1]]; 
-            glVertex3f(vertex1->position[0], vertex1->position[1], vertex1->position[2]);
-            glVertex3f(vertex2->position[0], vertex2->position[1], vertex2->position[2]);
-        }
-    }
+void ply::renderPolylines(const vector<polyline>& polylines) {
+	for (size_t i = 0; i < polylines.size(); i++) {
+		const vector<int>& chain = polylines[i].vertices;
+		glBegin(polylines[i].closed ? GL_LINE_LOOP : GL_LINE_STRIP);
+		for (size_t j = 0; j < chain.size(); j++) {
+			glVertex3fv(glm::value_ptr(vertexList[chain[j]]->position));
+		}
+		glEnd();
+	}
+}
 
-	glEnd();
-	glPopMatrix();
+void ply::getSilhouettePolylines(vector<polyline>& polylines) {
+	silhouetteEdges.clear();
+	for (int i = 0; i < edgeCount; i++) {
+		// if frontFace values are not equal, they are either [1,0] or [0,1]
+		// in either case, one face is front-facing and the other is back-facing
+		if (faceList[edgeList[i]->faces[0]]->frontFace != faceList[edgeList[i]->faces[1]]->frontFace) {
+			silhouetteEdges.push_back(i);
+		}
+	}
+	chainEdges(silhouetteEdges, polylines);
+}
+
+void ply::getSilhouettePolylines(const vector<unsigned char>& frontFaces, vector<polyline>& polylines) {
+	getSilhouettePolylines(frontFaces, silhouetteEdges, polylines);
+}
+
+void ply::getSilhouettePolylines(const vector<unsigned char>& frontFaces, vector<int>& edges, vector<polyline>& polylines) {
+	edges.clear();
+	if ((int)frontFaces.size() >= faceCount) {
+		for (int i = 0; i < edgeCount; i++) {
+			if (frontFaces[edgeList[i]->faces[0]] != frontFaces[edgeList[i]->faces[1]]) {
+				edges.push_back(i);
+			}
+		}
+	}
+	chainEdges(edges, polylines);
+}
+
+/*  ===============================================
+	  Desc: Links the given edges (indices into edgeList) into polylines
+	  Chains start at vertices that do not have exactly two of the edges
+	  (open ends and crossings) and stop at the next such vertex; the
+	  edges left over after that form closed loops.
+	=============================================== */
+void ply::chainEdges(const vector<int>& edges, vector<polyline>& polylines) {
+	polylines.clear();
+	int count = (int)edges.size();
+
+	// (vertex, edge) for both ends of every edge, sorted by vertex, so the
+	// edges at a vertex are one contiguous range
+	vector<pair<int, int> > ends(2 * count);
+	for (int k = 0; k < count; k++) {
+		ends[2 * k] = make_pair(edgeList[edges[k]]->vertices[0], k);
+		ends[2 * k + 1] = make_pair(edgeList[edges[k]]->vertices[1], k);
+	}
+	sort(ends.begin(), ends.end());
+
+	vector<char> used(count, 0);
+	// first entry of ends for a vertex, and how many there are
+	struct incidence { int first; int degree; };
+	auto lookup = [&](int vertexIndex) {
+		vector<pair<int, int> >::iterator it = lower_bound(ends.begin(), ends.end(), make_pair(vertexIndex, -1));
+		incidence result = { (int)(it - ends.begin()), 0 };
+		while (it != ends.end() && it->first == vertexIndex) {
+			result.degree++;
+			++it;
+		}
+		return result;
+	};
+	auto walk = [&](int start, int k) {
+		polyline chain;
+		chain.vertices.push_back(start);
+		int current = start;
+		while (k >= 0) {
+			used[k] = 1;
+			edge* e = edgeList[edges[k]];
+			current = e->vertices[0] == current ? e->vertices[1] : e->vertices[0];
+			chain.vertices.push_back(current);
+
+			incidence at = lookup(current);
+			k = -1;
+			if (at.degree == 2) {
+				for (int i = at.first; i < at.first + 2; i++) {
+					if (!used[ends[i].second]) {
+						k = ends[i].second;
+					}
+				}
+			}
+		}
+		if (chain.vertices.size() > 2 && chain.vertices.back() == chain.vertices.front()) {
+			chain.vertices.pop_back();
+			chain.closed = true;
+		}
+		polylines.push_back(chain);
+	};
+
+	// open chains, from every vertex that is not in the middle of one
+	for (int i = 0; i < 2 * count;) {
+		int vertexIndex = ends[i].first;
+		int j = i;
+		while (j < 2 * count && ends[j].first == vertexIndex) {
+			j++;
+		}
+		if (j - i != 2) {
+			for (int e = i; e < j; e++) {
+				if (!used[ends[e].second]) {
+					walk(vertexIndex, ends[e].second);
+				}
+			}
+		}
+		i = j;
+	}
+
+	// what is left are loops
+	for (int k = 0; k < count; k++) {
+		if (!used[k]) {
+			walk(edgeList[edges[k]]->vertices[0], k);
+		}
+	}
 }
 
 /*  ===============================================
 	  Desc: Prints some statistics about the file you have read in
 	  This is useful for debugging information to see if we parse our file correctly.
 	=============================================== */
-void ply::printAttributes() {
-	cout << "==== ply Mesh Attributes=====" << endl;
-	cout << "vertex count:" << vertexCount << endl;
-	cout << "face count:" << faceCount << endl;
-	cout << "properties:" << properties << endl;
+void ply::printAttributes(ostream& out) {
+	out << "==== ply Mesh Attributes=====" << endl;
+	out << "vertex count:" << vertexCount << endl;
+	out << "face count:" << faceCount << endl;
+	out << "properties:" << properties << endl;
+	out << "edge count:" << edgeCount << endl;
+	out << "bvh nodes:" << faceBVH->getNodeCount() << endl;
+	out << "feature edges (30+ degrees):" << getFeatureEdgeCount(30.0f) << endl;
+	printMemoryUsage(out);
+	out << "load (ms):" << timing.total * 1000.0
+		<< " parse:" << timing.parse * 1000.0
+		<< " bounds:" << timing.bounds * 1000.0
+		<< " faces:" << timing.faces * 1000.0
+		<< " pipeline:" << timing.pipeline * 1000.0
+		<< " rescale:" << timing.rescale * 1000.0
+		<< " cleanup:" << timing.cleanup * 1000.0
+		<< " edges:" << timing.edges * 1000.0
+		<< " features:" << timing.features * 1000.0
+		<< " bvh:" << timing.bvh * 1000.0 << endl;
+	if (cleaned.applied) {
+		out << "cleanup welded vertices:" << cleaned.weldedVertices
+			<< " degenerate faces:" << cleaned.degenerateFaces
+			<< " duplicate faces:" << cleaned.duplicateFaces << endl;
+	}
+}
+
+/*  ===============================================
+	  Desc: Writes the (normalized) mesh as a binary PLY file
+	  Vertices are float x, y, z and faces a uchar-counted int list,
+	  in the byte order of this machine
+	  Returns false if the file cannot be written
+	=============================================== */
+bool ply::writeBinary(string outPath) {
+	ofstream out(outPath.c_str(), ios::out | ios::binary);
+	if (!out.is_open()) {
+		cout << "cannot write file " << outPath << "\n";
+		return false;
+	}
+
+	unsigned int one = 1;
+	bool littleEndian = *(unsigned char*)&one == 1;
+
+	out << "ply\n";
+	out << "format " << (littleEndian ? "binary_little_endian" : "binary_big_endian") << " 1.0\n";
+	out << "element vertex " << vertexCount << "\n";
+	out << "property float x\nproperty float y\nproperty float z\n";
+	out << "element face " << faceCount << "\n";
+	out << "property list uchar int vertex_indices\n";
+	out << "end_header\n";
+
+	// write in blocks so large meshes do not go through ofstream one
+	// value at a time
+	vector<char> block;
+	block.reserve(1 << 20);
+	for (int i = 0; i < vertexCount; i++) {
+		const char* position = (const char*)glm::value_ptr(vertexList[i]->position);
+		block.insert(block.end(), position, position + 3 * sizeof(float));
+		if (block.size() >= (1 << 20)) {
+			out.write(&block[0], block.size());
+			block.clear();
+		}
+	}
+	for (int i = 0; i < faceCount; i++) {
+		block.push_back((char)3);
+		const char* indices = (const char*)faceList[i]->vertexList;
+		block.insert(block.end(), indices, indices + 3 * sizeof(int));
+		if (block.size() >= (1 << 20)) {
+			out.write(&block[0], block.size());
+			block.clear();
+		}
+	}
+	if (!block.empty()) {
+		out.write(&block[0], block.size());
+	}
+	return out.good();
+}
+
+meshMemory ply::getMemoryUsage() {
+	meshMemory usage;
+	usage.positions = (size_t)vertexCount * sizeof(glm::vec3);
+	usage.indices = (size_t)faceCount * sizeof(int[3]);
+	usage.normals = (size_t)faceCount * sizeof(glm::vec3);
+	usage.edges = (size_t)edgeCount * sizeof(edge);
+	usage.gpu = displayListBytes + featureListBytes;
+	usage.auxiliary = (size_t)faceCount * sizeof(int)
+		+ faceBVH->getMemoryBytes()
+		+ ambientOcclusion.size() * sizeof(float)
+		+ silhouetteEdges.size() * sizeof(int)
+		+ silhouettePolylines.size() * sizeof(polyline)
+		+ featureEdges.size() * (sizeof(int) + sizeof(float));
+	for (size_t i = 0; i < silhouettePolylines.size(); i++) {
+		usage.auxiliary += silhouettePolylines[i].vertices.capacity() * sizeof(int);
+	}
+
+	// every vertex, face and edge sits behind a pointer; the allocator's
+	// own block headers depend on the platform and are not counted
+	usage.overhead = (size_t)vertexCount * (sizeof(vertex) - sizeof(glm::vec3) + sizeof(vertex*))
+		+ (size_t)faceCount * (sizeof(face) - sizeof(int[3]) - sizeof(glm::vec3) - sizeof(int) + sizeof(face*))
+		+ (size_t)edgeCount * sizeof(edge*)
+		+ vectorSlack(silhouetteEdges) + vectorSlack(silhouettePolylines)
+		+ vectorSlack(ambientOcclusion)
+		+ vectorSlack(featureEdges) + vectorSlack(featureAngles);
+	return usage;
+}
+
+size_t ply::getMemoryBytes() {
+	return getMemoryUsage().total();
+}
+
+void ply::printMemoryUsage(ostream& out) {
+	meshMemory usage = getMemoryUsage();
+	out << "memory (KB):" << usage.total() / 1024
+		<< " positions:" << usage.positions / 1024
+		<< " indices:" << usage.indices / 1024
+		<< " normals:" << usage.normals / 1024
+		<< " edges:" << usage.edges / 1024
+		<< " gpu:" << usage.gpu / 1024
+		<< " aux:" << usage.auxiliary / 1024
+		<< " overhead:" << usage.overhead / 1024 << endl;
+	if (!edgesEnabled || !bvhEnabled) {
+		out << "over memory budget, left out:"
+			<< (bvhEnabled ? "" : " bvh")
+			<< (edgesEnabled ? "" : " edges") << endl;
+	}
+}
+
+bool ply::pick(glm::vec3 origin, glm::vec3 direction, rayHit& hit) {
+	return faceBVH->intersect(origin, direction, hit);
 }
 
 /*  ===============================================
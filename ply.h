@@ -9,13 +9,111 @@
 #ifndef PLY_H
 #define PLY_H
 
+#include <iostream>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <glm/glm.hpp>
 #include "geometry.h"
+#include "bvh.h"
 
 using namespace std;
 
+/*  ============== edgeKey ==============
+        Purpose: One corner edge of a face, keyed by its two vertices
+        (smaller index in the high bits). Sorting the keys of every face
+        puts the faces sharing an edge next to each other (ply::findEdges).
+        ==================================== */
+struct edgeKey {
+        unsigned long long vertices;
+        int face;
+        int corner;
+};
+
+/*  ============== loadTiming ==============
+        Purpose: Where the last load's time went, in seconds. bounds and
+        faces are the time the pipeline stages spent on the worker pool
+        (they overlap parsing); pipeline is the wall time until parsing
+        and every stage were done, and total includes the rest.
+        ==================================== */
+struct loadTiming {
+        double parse;
+        double bounds;
+        double faces;
+        double pipeline;
+        double rescale;
+        double cleanup;
+        double edges;
+        double features;
+        double bvh;
+        double total;
+
+        loadTiming() : parse(0), bounds(0), faces(0), pipeline(0), rescale(0), cleanup(0), edges(0), features(0), bvh(0), total(0) {}
+};
+
+/*  ============== cleanupStats ==============
+        Purpose: What the load-time cleanup removed from the last load
+        (see setMeshCleanup); applied is false if it did not run
+        ==================================== */
+struct cleanupStats {
+        bool applied;
+        int weldedVertices;
+        int degenerateFaces;
+        int duplicateFaces;
+
+        cleanupStats() : applied(false), weldedVertices(0), degenerateFaces(0), duplicateFaces(0) {}
+};
+
+/*  ============== meshMemory ==============
+        Purpose: Where the bytes of one loaded mesh go (ply::getMemoryUsage)
+
+        Payload fields count only the data itself; overhead counts what
+        the layout adds on top: the per-object heap block headers and
+        padding of every vertex, face and edge, the pointer arrays that
+        index them, and unused vector capacity. gpu is an estimate of the
+        display list the driver keeps for renderCached.
+        ==================================== */
+struct meshMemory {
+        size_t positions;
+        size_t indices;
+        size_t normals;
+        size_t edges;
+        size_t gpu;
+        // BVH, front-face flags, ambient occlusion, silhouette buffers
+        size_t auxiliary;
+        // pointer arrays, struct padding and unused vector capacity
+        // (heap block headers are left out)
+        size_t overhead;
+
+        size_t total() { return positions + indices + normals + edges + gpu + auxiliary + overhead; }
+};
+
+/*  ===============================================
+        Desc: Process-wide memory budget for a single mesh, in bytes
+        (0, the default, means no limit). A mesh whose vertices and faces
+        plus its optional structures would go over the budget is loaded
+        without them, dropping the BVH (no picking) first, then the edge
+        list (no silhouette). Normal lines are drawn straight from the
+        faces and need no memory of their own.
+=============================================== */
+void setMeshMemoryBudget(size_t bytes);
+size_t getMeshMemoryBudget();
+
+/*  ===============================================
+        Desc: Process-wide load-time cleanup (off by default). When on,
+        every load welds vertices less than weldTolerance apart, in the
+        normalized units the mesh is scaled to (1 across its largest
+        extent; 0 welds only vertices at exactly the same position), then
+        drops the faces that are left degenerate and the faces that
+        repeat another face's three vertices. Scanned models often carry
+        both, and they give NaN normals and bogus silhouette edges.
+=============================================== */
+void setMeshCleanup(bool enabled, float weldTolerance = 0.0f);
+bool getMeshCleanup();
+float getMeshWeldTolerance();
+
 /*  ============== ply ==============
         Purpose: Load a PLY File
 
@@ -45,11 +143,32 @@ class ply {
                         Desc: reloads the geometry for a 3D object
                         (usually to see a new .ply file)
                 =============================================== */ 
-                void reload(string _filePath);
+                bool reload(string _filePath);
+                /*      ===============================================
+                        Desc: Progressive loading. beginLoad reads the file
+                        on a background thread; renderProgress draws the
+                        points and faces read so far while isLoading(), and
+                        the finished mesh afterwards. Nothing else may be
+                        called until isLoading() is false and finishLoad()
+                        has returned (it waits, and reports success).
+                =============================================== */
+                void beginLoad(string _filePath);
+                bool isLoading() { return loading; }
+                bool finishLoad();
+                int getLoadedVertexCount();
+				void renderProgress();
                 /*      ===============================================
-                        Desc: Draws a filled 3D object
+                        Desc: Draws a filled 3D object. With occlusion set
+                        (and occlusion baked, see occlusion.h) each vertex
+                        colour is scaled by its ambient occlusion; use
+                        smooth shading to see it blend across faces.
                 =============================================== */  
-				void render(int frontvBackFace=0);
+				void render(int frontvBackFace=0, bool occlusion=false);
+                /*      ===============================================
+                        Desc: Draws the filled mesh with one colour per
+                        vertex (e.g. a deviation map, see meshcompare.h)
+                =============================================== */
+				void renderColored(const vector<glm::vec3>& colors);
 				void renderNormal();
 				//iterates through the geometry to fill in the edgeList
                 //draws the silhouette around the ply object
@@ -57,10 +176,109 @@ class ply {
 
 				void computeFrontFace(glm::vec3 lookVector);
 
+                /*      ===============================================
+                        Desc: Variants used when the same mesh is drawn as
+                        several instances (see scene.h). The front-face flags
+                        are written to the caller's buffer instead of faceList,
+                        so every instance keeps its own copy.
+                =============================================== */
+				void computeFrontFace(glm::vec3 lookVector, vector<unsigned char>& frontFaces);
+				void renderSilhouette(const vector<unsigned char>& frontFaces);
+
+                /*      ===============================================
+                        Desc: The silhouette as polylines: silhouette edges
+                        linked through shared vertices into ordered chains
+                        and loops. The first form uses the front faces from
+                        computeFrontFace(lookVector), the second the
+                        caller's per-instance flags. The third form keeps
+                        its silhouette edges in the caller's edges buffer
+                        and only reads the mesh, so several threads may
+                        call it at once (see svgexport.h).
+                        Useful for stylized or exported outlines.
+                =============================================== */
+				void getSilhouettePolylines(vector<polyline>& polylines);
+				void getSilhouettePolylines(const vector<unsigned char>& frontFaces, vector<polyline>& polylines);
+				void getSilhouettePolylines(const vector<unsigned char>& frontFaces, vector<int>& edges, vector<polyline>& polylines);
+                /*      ===============================================
+                        Desc: Draws the given silhouette edges (indices into
+                        the edge list, e.g. from silhouetteTracker) as
+                        polylines
+                =============================================== */
+				void renderSilhouetteEdges(const vector<int>& edges);
+                /*      ===============================================
+                        Desc: Draws the filled mesh from a display list that is
+                        compiled on first use and shared by every caller
+                        (requires a current GL context)
+                =============================================== */
+				void renderCached();
+                /*      ===============================================
+                        Desc: Feature (crease) edges: edges whose two faces
+                        meet at minAngle degrees or more, measured between
+                        the face normals (0 for a flat edge). The angles are
+                        worked out once at load and the edges kept sharpest
+                        first, so any threshold is a prefix of that order.
+                        renderFeatureEdges draws them from display lists
+                        compiled on first use, one per degree of angle from
+                        1 degree up, so changing the threshold only changes
+                        which lists are replayed (requires a current GL
+                        context). Edges under 1 degree are not drawn.
+                =============================================== */
+				void renderFeatureEdges(int minAngle);
+				int getFeatureEdgeCount(float minAngle);
+				const vector<int>& getFeatureEdges() { return featureEdges; }
+				const vector<float>& getFeatureAngles() { return featureAngles; }
+                /*      ===============================================
+                        Desc: Casts a ray (in the mesh's normalized object
+                        space) against the face BVH built at load time.
+                        Returns false if the ray misses the mesh.
+                =============================================== */
+				bool pick(glm::vec3 origin, glm::vec3 direction, rayHit& hit);
+
+                string getFilePath() { return filePath; }
+                int getVertexCount() { return vertexCount; }
+                int getFaceCount() { return faceCount; }
+                int getEdgeCount() { return edgeCount; }
+                vertex* getVertex(int i) { return vertexList[i]; }
+                face* getFace(int i) { return faceList[i]; }
+                edge* getEdge(int i) { return edgeList[i]; }
+                bvh* getBVH() { return faceBVH; }
+                /*      ===============================================
+                        Desc: How the file's coordinates were normalized
+                        at load: a vertex was at
+                        position * getOriginalScale() + getOriginalCenter()
+                        in the file, so distances times the scale are in
+                        the file's units
+                =============================================== */
+                glm::vec3 getOriginalCenter() { return originalCenter; }
+                float getOriginalScale() { return originalScale; }
+                // per-vertex ambient occlusion (empty until baked)
+                void setAmbientOcclusion(const vector<float>& values) { ambientOcclusion = values; }
+                bool hasAmbientOcclusion() { return !ambientOcclusion.empty(); }
+
                 /*      ===============================================
                         Desc: Prints some statistics about the file you have read in
                 =============================================== */  
-                void printAttributes();
+                void printAttributes(ostream& out = cout);
+                /*      ===============================================
+                        Desc: Bytes held by the mesh, per structure
+                        (see meshMemory), and their total (used by
+                        meshCache to stay within its budget)
+                =============================================== */
+                meshMemory getMemoryUsage();
+                size_t getMemoryBytes();
+                void printMemoryUsage(ostream& out = cout);
+                /*      ===============================================
+                        Desc: Whether the optional structures were built
+                        (see setMeshMemoryBudget)
+                =============================================== */
+                bool hasEdges() { return edgesEnabled; }
+                bool hasBVH() { return bvhEnabled; }
+                loadTiming getLoadTiming() { return timing; }
+                cleanupStats getCleanupStats() { return cleaned; }
+                /*      ===============================================
+                        Desc: Writes the mesh as a binary .ply file
+                =============================================== */
+                bool writeBinary(string outPath);
                 /*  ===============================================
                         Desc: Helper function for you to debug if 
                         you are reading in the correct data.
@@ -75,10 +293,16 @@ class ply {
                         Desc: Helper function used in the constructor
                         =============================================== */ 
 			void findEdges();
-			void loadGeometry();
-			void computeFaceNormals();
+			void edgesFromKeys(const vector<edgeKey>& keys);
+			void findFeatureEdges();
+			void chainEdges(const vector<int>& edges, vector<polyline>& polylines);
+			void renderPolylines(const vector<polyline>& polylines);
+			bool loadGeometry();
+			bool loadGeometryOrFail();
+			void computeFaceNormals(vertex** vertices, int count, face** faces, int begin, int end, bool parallel);
+			bool cleanup(float tolerance);
             //makes the points fit in the window
-            void scaleAndCenter();
+            void scaleAndCenter(glm::vec3 sum, glm::vec3 low, glm::vec3 high);
 
                 /*      ===============================================
                         Data
@@ -106,6 +330,46 @@ class ply {
 				face** faceList;
                 //an array of linked lists representing edges
                 edge** edgeList;
+                // hierarchy over faceList, rebuilt by every load
+                bvh* faceBVH;
+                // GL display list holding the filled mesh, 0 until renderCached
+                unsigned int displayList;
+                size_t displayListBytes;
+                // every edge, sharpest first, and its angle in degrees
+                vector<int> featureEdges;
+                vector<float> featureAngles;
+                // FEATURE_LISTS display lists from featureLists on, list
+                // i holding the edges of i + 1 to i + 2 degrees; 0 until
+                // drawn
+                unsigned int featureLists;
+                size_t featureListBytes;
+                loadTiming timing;
+                cleanupStats cleaned;
+                // one value per vertex, see occlusion.h
+                vector<float> ambientOcclusion;
+                // optional structures left out to stay within the budget
+                bool edgesEnabled;
+                bool bvhEnabled;
+                // reused every frame by renderSilhouette
+                vector<int> silhouetteEdges;
+                vector<polyline> silhouettePolylines;
+
+                // background loading (beginLoad). loadLock guards the
+                // partial geometry below, which renderProgress draws
+                thread loader;
+                mutex loadLock;
+                atomic<bool> loading;
+                atomic<bool> cancelLoad;
+                bool loadSucceeded;
+                vertex** loadingVertices;
+                int loadedVertices;
+                vector<face*> loadingFaces;
+                // normalization estimated from the first vertex batch
+                glm::vec3 previewCenter;
+                float previewScale;
+                // the normalization scaleAndCenter applied
+                glm::vec3 originalCenter;
+                float originalScale;
 };
 
 #endif
\ No newline at end of file
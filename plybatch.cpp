@@ -0,0 +1,353 @@
+/*  =================== File Information =================
+    File Name: plybatch.cpp
+    Description: Command-line loader/converter for many .ply files
+
+    Purpose: Loads, normalizes and computes normals and edges for every
+             .ply file given (directories are searched recursively, and
+             .ply.gz / .ply.zst files are read compressed) without
+             opening a window. One task per file runs on the shared worker
+             pool; each load also runs its own per-face loops on the same
+             pool, so large files keep every core busy too.
+    Usage:   plybatch [-j threads] [-o outdir] [-q] [-l listfile] [-s] [-m MB] [-w tolerance] [-a rays] <file|dir>...
+             -j  number of threads (default: all cores)
+             -o  write each processed mesh to outdir as a binary .ply
+                 of the same name; two inputs with the same name are
+                 an error
+             -q  do not print per-file attributes
+             -l  read more paths from listfile, one per line
+             -s  check the incremental silhouette tracker and the
+                 silhouette cache against the brute-force silhouette
+                 over a 360 degree orbit
+             -m  per-mesh memory budget; larger meshes are loaded
+                 without their optional structures (setMeshMemoryBudget)
+             -w  clean up each mesh as it loads: weld vertices closer
+                 than tolerance (normalized units, 0 for exact
+                 duplicates) and drop degenerate and duplicate faces
+                 (setMeshCleanup)
+             -a  bake ambient occlusion with this many rays per vertex
+                 and write it next to each model (<model>.ao)
+    ===================================================== */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "occlusion.h"
+#include "parallel.h"
+#include "ply.h"
+#include "plystream.h"
+#include "silhouette.h"
+
+using namespace std;
+
+
+// Totals over every file, updated by the tasks under statsMutex
+struct batchStats {
+    int    files;
+    int    failed;
+    // loaded and written, but the -s silhouette check found a mismatch
+    int    checkFailed;
+    long   vertices;
+    long   faces;
+    long   edges;
+    double inputBytes;
+};
+
+static mutex outputMutex;
+
+static bool isDirectory(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static double fileBytes(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (double)info.st_size : 0.0;
+}
+
+// .ply, or a compressed .ply.gz / .ply.zst (see plystream.h)
+static bool hasPlyExtension(const string &name) {
+    string plain = stripCompressionExtension(name);
+    return plain.size() > 4 && plain.compare(plain.size() - 4, 4, ".ply") == 0;
+}
+
+static string baseName(const string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// Adds every .ply file under dir (recursively) to files
+static void collectDirectory(const string &dir, vector<string> &files) {
+    DIR *handle = opendir(dir.c_str());
+    if (handle == NULL) {
+        cout << "cannot open directory " << dir << endl;
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        string path = dir + "/" + name;
+        if (isDirectory(path)) {
+            collectDirectory(path, files);
+        }
+        else if (hasPlyExtension(name)) {
+            files.push_back(path);
+        }
+    }
+    closedir(handle);
+}
+
+static void collectPath(const string &path, vector<string> &files) {
+    if (isDirectory(path)) {
+        collectDirectory(path, files);
+    }
+    else {
+        files.push_back(path);
+    }
+}
+
+static void usage() {
+    cout << "usage: plybatch [-j threads] [-o outdir] [-q] [-l listfile] [-s] [-m MB] [-w tolerance] [-a rays] <file|dir>..." << endl;
+}
+
+// Same orbit through a silhouetteCache, comparing each frame's edge set
+// with the brute-force one. Returns the number of frames that differ.
+static int checkSilhouetteCache(ply &mesh, ostream &report) {
+    silhouetteTracker brute;
+    brute.setMesh(&mesh);
+    silhouetteCache cache;
+    cache.build(&mesh);
+
+    int       badFrames = 0;
+    long long tested    = 0;
+    double    cacheSeconds = 0.0;
+    vector<int> expected, found;
+    for (int step = 0; step < 360; step++) {
+        float     yaw   = glm::radians((float)step + 0.5f);
+        float     pitch = glm::radians(20.0f * sin(yaw * 3.0f));
+        glm::vec3 look(sin(yaw) * cos(pitch), sin(pitch), -cos(yaw) * cos(pitch));
+
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        found = cache.update(look);
+        cacheSeconds += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        tested += cache.lastEdgesTested;
+
+        brute.computeAll(glm::normalize(look), expected);
+        sort(found.begin(), found.end());
+        if (found != expected) {
+            badFrames++;
+        }
+    }
+
+    report << "silhouette cache check: " << badFrames << " of 360 frames differ, "
+           << cache.sampleCount << " samples, band " << cache.bandAngle << " degrees, "
+           << cache.getMemoryBytes() / (1024.0 * 1024.0) << " MB, built in " << cache.buildSeconds
+           << " s, edges tested per frame " << tested / 360 << ", "
+           << cacheSeconds * 1000.0 / 360 << " ms per frame" << endl;
+    return badFrames;
+}
+
+// Orbits the mesh one degree per frame (tilting slowly as well) and
+// compares every tracked silhouette with the brute-force one.
+// Returns the number of frames where the tracker missed an edge.
+static int checkSilhouette(ply &mesh, ostream &report) {
+    silhouetteTracker tracker;
+    tracker.setMesh(&mesh);
+
+    int       badFrames = 0;
+    long long tested    = 0;
+    double    trackSeconds = 0.0, bruteSeconds = 0.0;
+    vector<int> expected;
+    for (int step = 0; step < 360; step++) {
+        float     yaw   = glm::radians((float)step);
+        float     pitch = glm::radians(20.0f * sin(yaw * 3.0f));
+        glm::vec3 look(sin(yaw) * cos(pitch), sin(pitch), -cos(yaw) * cos(pitch));
+
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        tracker.update(look);
+        chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+        tracker.computeAll(look, expected);
+        chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+        trackSeconds += chrono::duration<double>(t1 - t0).count();
+        bruteSeconds += chrono::duration<double>(t2 - t1).count();
+        tested += tracker.lastEdgesTested;
+        if (tracker.countMissing(look) > 0) {
+            badFrames++;
+        }
+    }
+
+    report << "silhouette check: " << badFrames << " of 360 frames missed edges, "
+           << "edges tested per frame " << tested / 360 << " of " << mesh.getEdgeCount()
+           << ", full passes " << tracker.fullRecomputes
+           << ", tracked " << trackSeconds * 1000.0 / 360 << " ms vs brute force "
+           << bruteSeconds * 1000.0 / 360 << " ms per frame" << endl;
+    return badFrames + checkSilhouetteCache(mesh, report);
+}
+
+
+/**************************************** main() ********************/
+int main(int argc, char **argv) {
+    vector<string> files;
+    string         outDir;
+    bool           quiet = false;
+    bool           checkTracker = false;
+    int            occlusionRays = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            setThreadCount(atoi(argv[++i]));
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            outDir = argv[++i];
+        }
+        else if (arg == "-q") {
+            quiet = true;
+        }
+        else if (arg == "-s") {
+            checkTracker = true;
+        }
+        else if (arg == "-a" && i + 1 < argc) {
+            occlusionRays = atoi(argv[++i]);
+        }
+        else if (arg == "-m" && i + 1 < argc) {
+            setMeshMemoryBudget((size_t)(atof(argv[++i]) * 1024 * 1024));
+        }
+        else if (arg == "-w" && i + 1 < argc) {
+            setMeshCleanup(true, (float)atof(argv[++i]));
+        }
+        else if (arg == "-l" && i + 1 < argc) {
+            ifstream list(argv[++i]);
+            string   line;
+            while (getline(list, line)) {
+                if (!line.empty()) {
+                    collectPath(line, files);
+                }
+            }
+        }
+        else if (arg[0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            collectPath(arg, files);
+        }
+    }
+
+    if (files.empty()) {
+        usage();
+        return 1;
+    }
+
+    // every output lands in the one directory, so two inputs of the same
+    // name would overwrite each other's output
+    if (!outDir.empty()) {
+        map<string, string> outputs;
+        for (size_t i = 0; i < files.size(); i++) {
+            string name = stripCompressionExtension(baseName(files[i]));
+            if (!outputs.insert(make_pair(name, files[i])).second) {
+                cout << "both " << outputs[name] << " and " << files[i] << " would be written to " << outDir
+                     << "/" << name << endl;
+                return 1;
+            }
+        }
+    }
+
+    batchStats stats = { 0, 0, 0, 0, 0, 0, 0.0 };
+    mutex      statsMutex;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    {
+        taskGroup group;
+        for (size_t i = 0; i < files.size(); i++) {
+            string path = files[i];
+            group.run([&, path]() {
+                chrono::steady_clock::time_point fileStart = chrono::steady_clock::now();
+                ply  mesh;
+                bool loaded  = mesh.reload(path);
+                bool written = true;
+                if (loaded && !outDir.empty()) {
+                    written = mesh.writeBinary(outDir + "/" + stripCompressionExtension(baseName(path)));
+                }
+                double seconds =
+                    chrono::duration<double>(chrono::steady_clock::now() - fileStart).count();
+
+                ostringstream check;
+                bool checkFailed = loaded && checkTracker && checkSilhouette(mesh, check) > 0;
+                if (loaded && occlusionRays > 0) {
+                    occlusionBaker baker;
+                    baker.rayCount = occlusionRays;
+                    vector<float> occlusion;
+                    chrono::steady_clock::time_point bakeStart = chrono::steady_clock::now();
+                    baker.bake(&mesh, occlusion);
+                    double bakeSeconds =
+                        chrono::duration<double>(chrono::steady_clock::now() - bakeStart).count();
+                    if (!baker.saveCache(&mesh, occlusion)) {
+                        written = false;
+                    }
+                    check << "ambient occlusion: " << occlusionRays << " rays per vertex in "
+                          << bakeSeconds << " s, " << occlusionBaker::cachePath(&mesh) << endl;
+                }
+
+                {
+                    lock_guard<mutex> lock(statsMutex);
+                    stats.files++;
+                    if (!loaded || !written) {
+                        stats.failed++;
+                    }
+                    if (checkFailed) {
+                        stats.checkFailed++;
+                    }
+                    stats.vertices += mesh.getVertexCount();
+                    stats.faces += mesh.getFaceCount();
+                    stats.edges += mesh.getEdgeCount();
+                    stats.inputBytes += fileBytes(path);
+                }
+
+                // reload has printed why a file failed; an empty mesh has
+                // nothing more to report
+                if (loaded && (!quiet || checkTracker || occlusionRays > 0)) {
+                    ostringstream report;
+                    report << path << " (" << seconds * 1000.0 << " ms)" << endl;
+                    if (!quiet) {
+                        mesh.printAttributes(report);
+                    }
+                    report << check.str();
+                    lock_guard<mutex> lock(outputMutex);
+                    cout << report.str();
+                }
+            });
+        }
+        group.wait();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "==== plybatch totals =====" << endl;
+    cout << "threads:" << getThreadCount() << endl;
+    cout << "files:" << stats.files << " failed:" << stats.failed << endl;
+    if (checkTracker) {
+        cout << "silhouette check failed:" << stats.checkFailed << endl;
+    }
+    cout << "vertices:" << stats.vertices << " faces:" << stats.faces << " edges:" << stats.edges << endl;
+    cout << "seconds:" << seconds << endl;
+    cout << "files/s:" << stats.files / seconds << endl;
+    cout << "faces/s:" << stats.faces / seconds << endl;
+    cout << "MB/s:" << stats.inputBytes / (1024.0 * 1024.0) / seconds << endl;
+
+    return stats.failed == 0 && stats.checkFailed == 0 ? 0 : 1;
+}
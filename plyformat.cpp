@@ -0,0 +1,571 @@
+/*  =================== File Information =================
+  File Name: plyformat.cpp
+  Description: Parses the PLY header and decodes vertex and face records
+  ===================================================== */
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "plyformat.h"
+
+using namespace std;
+
+// the buffer always keeps this much room so one token or record never
+// straddles a refill
+static const size_t READ_BLOCK = 1 << 20;
+
+static plyType parseType(const string& name) {
+	if (name == "char" || name == "int8") return PLY_CHAR;
+	if (name == "uchar" || name == "uint8") return PLY_UCHAR;
+	if (name == "short" || name == "int16") return PLY_SHORT;
+	if (name == "ushort" || name == "uint16") return PLY_USHORT;
+	if (name == "int" || name == "int32") return PLY_INT;
+	if (name == "uint" || name == "uint32") return PLY_UINT;
+	if (name == "float" || name == "float32") return PLY_FLOAT;
+	if (name == "double" || name == "float64") return PLY_DOUBLE;
+	return PLY_INVALID;
+}
+
+static size_t typeSize(plyType type) {
+	switch (type) {
+	case PLY_CHAR: case PLY_UCHAR: return 1;
+	case PLY_SHORT: case PLY_USHORT: return 2;
+	case PLY_INT: case PLY_UINT: case PLY_FLOAT: return 4;
+	case PLY_DOUBLE: return 8;
+	default: return 0;
+	}
+}
+
+static bool hostIsLittleEndian() {
+	unsigned int one = 1;
+	return *(unsigned char*)&one == 1;
+}
+
+// copies size bytes from source, reversing them if swap is set
+static inline void loadBytes(void* dest, const char* source, size_t size, bool swap) {
+	if (!swap) {
+		memcpy(dest, source, size);
+		return;
+	}
+	char* out = (char*)dest;
+	for (size_t i = 0; i < size; i++) {
+		out[i] = source[size - 1 - i];
+	}
+}
+
+int plyElement::findProperty(const string& propertyName) const {
+	for (int i = 0; i < (int)properties.size(); i++) {
+		if (properties[i].name == propertyName) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int plyHeader::findElement(const string& elementName) const {
+	for (int i = 0; i < (int)elements.size(); i++) {
+		if (elements[i].name == elementName) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int plyHeader::propertyCount() const {
+	int count = 0;
+	for (int i = 0; i < (int)elements.size(); i++) {
+		count += (int)elements[i].properties.size();
+	}
+	return count;
+}
+
+double plyHeader::minimumDataBytes() const {
+	double total = 0.0;
+	for (int i = 0; i < (int)elements.size(); i++) {
+		size_t record = 0;
+		for (int p = 0; p < (int)elements[i].properties.size(); p++) {
+			const plyProperty& property = elements[i].properties[p];
+			record += typeSize(property.isList ? property.countType : property.type);
+		}
+		total += (double)elements[i].count * record;
+	}
+	return total;
+}
+
+plyReader::plyReader(istream& _in) : in(_in) {
+	buffer.resize(2 * READ_BLOCK + 1);
+	pos = 0;
+	end = 0;
+	eof = false;
+	lineBytes = 0;
+}
+
+/*  ===============================================
+	  Desc: Makes sure at least need bytes are buffered (fewer only at the
+	  end of the stream). Unread bytes move to the front before refilling.
+	  The byte after the data is always '\0' so strtod and friends stop.
+	=============================================== */
+bool plyReader::fill(size_t need) {
+	if (end - pos >= need) {
+		return true;
+	}
+	if (!eof) {
+		memmove(&buffer[0], &buffer[pos], end - pos);
+		end -= pos;
+		pos = 0;
+		while (!eof && end < buffer.size() - 1 - READ_BLOCK / 2) {
+			in.read(&buffer[end], buffer.size() - 1 - end);
+			end += (size_t)in.gcount();
+			if (in.gcount() == 0 || !in) {
+				eof = true;
+			}
+		}
+		buffer[end] = '\0';
+	}
+	return end - pos >= need;
+}
+
+bool plyReader::readLine(string& line) {
+	line.clear();
+	while (true) {
+		if (pos == end && !fill(1)) {
+			return !line.empty();
+		}
+		char c = buffer[pos++];
+		lineBytes++;
+		if (c == '\n') {
+			break;
+		}
+		if (c != '\r') {
+			line += c;
+		}
+	}
+	return true;
+}
+
+bool plyReader::readHeader(plyHeader& header, string& error) {
+	string line;
+	header.elements.clear();
+	header.format = PLY_ASCII;
+	header.headerBytes = 0;
+
+	if (!readLine(line) || line != "ply") {
+		error = "missing 'ply' magic line";
+		return false;
+	}
+
+	bool haveFormat = false;
+	while (readLine(line)) {
+		istringstream words(line);
+		string keyword;
+		words >> keyword;
+
+		if (keyword == "format") {
+			string format;
+			words >> format;
+			if (format == "ascii") header.format = PLY_ASCII;
+			else if (format == "binary_little_endian") header.format = PLY_BINARY_LITTLE_ENDIAN;
+			else if (format == "binary_big_endian") header.format = PLY_BINARY_BIG_ENDIAN;
+			else {
+				error = "unknown format " + format;
+				return false;
+			}
+			haveFormat = true;
+		}
+		else if (keyword == "element") {
+			plyElement element;
+			element.count = -1;
+			words >> element.name >> element.count;
+			if (element.name.empty() || element.count < 0) {
+				error = "bad element line: " + line;
+				return false;
+			}
+			header.elements.push_back(element);
+		}
+		else if (keyword == "property") {
+			if (header.elements.empty()) {
+				error = "property before any element: " + line;
+				return false;
+			}
+			plyProperty property;
+			string type;
+			words >> type;
+			property.isList = type == "list";
+			property.countType = PLY_INVALID;
+			if (property.isList) {
+				string countType;
+				words >> countType >> type;
+				property.countType = parseType(countType);
+			}
+			property.type = parseType(type);
+			words >> property.name;
+			if (property.type == PLY_INVALID || (property.isList && property.countType == PLY_INVALID)) {
+				error = "bad property line: " + line;
+				return false;
+			}
+			header.elements.back().properties.push_back(property);
+		}
+		else if (keyword == "end_header") {
+			if (!haveFormat) {
+				error = "missing format line";
+				return false;
+			}
+			header.headerBytes = lineBytes;
+			return true;
+		}
+		// comment, obj_info and blank lines are ignored
+	}
+
+	error = "missing end_header";
+	return false;
+}
+
+bool plyReader::skipSpace() {
+	while (true) {
+		if (pos == end && !fill(1)) {
+			return false;
+		}
+		char c = buffer[pos];
+		if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+			break;
+		}
+		pos++;
+	}
+	// keep a whole token in memory
+	fill(64);
+	return true;
+}
+
+bool plyReader::asciiFloat(float& value) {
+	if (!skipSpace()) {
+		return false;
+	}
+	char* stop;
+	value = strtof(&buffer[pos], &stop);
+	if (stop == &buffer[pos]) {
+		return false;
+	}
+	pos = stop - &buffer[0];
+	return true;
+}
+
+bool plyReader::asciiInt(int& value) {
+	if (!skipSpace()) {
+		return false;
+	}
+	const char* c = &buffer[pos];
+	bool negative = false;
+	if (*c == '-' || *c == '+') {
+		negative = *c == '-';
+		c++;
+	}
+	if (*c < '0' || *c > '9') {
+		return false;
+	}
+	int result = 0;
+	while (*c >= '0' && *c <= '9') {
+		result = result * 10 + (*c - '0');
+		c++;
+	}
+	value = negative ? -result : result;
+	pos = c - &buffer[0];
+	return true;
+}
+
+bool plyReader::asciiSkip() {
+	if (!skipSpace()) {
+		return false;
+	}
+	while (pos < end && buffer[pos] != ' ' && buffer[pos] != '\t' && buffer[pos] != '\n' && buffer[pos] != '\r') {
+		pos++;
+	}
+	return true;
+}
+
+const char* plyReader::take(size_t size) {
+	if (!fill(size)) {
+		return NULL;
+	}
+	const char* record = &buffer[pos];
+	pos += size;
+	return record;
+}
+
+bool plyReader::value(plyType type, plyEncoding format, double& result) {
+	if (format == PLY_ASCII) {
+		if (!skipSpace()) {
+			return false;
+		}
+		char* stop;
+		result = strtod(&buffer[pos], &stop);
+		if (stop == &buffer[pos]) {
+			return false;
+		}
+		pos = stop - &buffer[0];
+		return true;
+	}
+
+	size_t size = typeSize(type);
+	const char* bytes = take(size);
+	if (bytes == NULL) {
+		return false;
+	}
+	bool swap = (format == PLY_BINARY_LITTLE_ENDIAN) != hostIsLittleEndian();
+	switch (type) {
+	case PLY_CHAR: { signed char v; loadBytes(&v, bytes, 1, false); result = v; break; }
+	case PLY_UCHAR: { unsigned char v; loadBytes(&v, bytes, 1, false); result = v; break; }
+	case PLY_SHORT: { short v; loadBytes(&v, bytes, 2, swap); result = v; break; }
+	case PLY_USHORT: { unsigned short v; loadBytes(&v, bytes, 2, swap); result = v; break; }
+	case PLY_INT: { int v; loadBytes(&v, bytes, 4, swap); result = v; break; }
+	case PLY_UINT: { unsigned int v; loadBytes(&v, bytes, 4, swap); result = v; break; }
+	case PLY_FLOAT: { float v; loadBytes(&v, bytes, 4, swap); result = v; break; }
+	case PLY_DOUBLE: { double v; loadBytes(&v, bytes, 8, swap); result = v; break; }
+	default: return false;
+	}
+	return true;
+}
+
+/*  ============== vertex layouts ==============
+	Purpose: The record shapes that get their own decoder. Every layout
+	starts with float x, y, z, followed by FLOATS - 3 more floats and then
+	UCHARS unsigned chars, all of which are skipped.
+	==================================== */
+template <int FLOATS, int UCHARS>
+struct vertexLayout {
+	enum { floats = FLOATS, uchars = UCHARS, recordSize = FLOATS * 4 + UCHARS };
+};
+typedef vertexLayout<3, 0> layoutXYZ;             // x y z
+typedef vertexLayout<5, 0> layoutXYZConfidence;   // x y z confidence intensity
+typedef vertexLayout<6, 0> layoutXYZNormal;       // x y z nx ny nz
+typedef vertexLayout<3, 3> layoutXYZColor;        // x y z red green blue
+
+template <class Layout>
+static bool decodeAsciiVertices(plyReader& reader, vertex** vertexList, int start, int count) {
+	for (int i = start; i < start + count; i++) {
+		glm::vec3& position = vertexList[i]->position;
+		bool ok = reader.asciiFloat(position.x) && reader.asciiFloat(position.y) && reader.asciiFloat(position.z);
+		for (int k = 3; k < Layout::floats + Layout::uchars; k++) {
+			ok = ok && reader.asciiSkip();
+		}
+		if (!ok) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class Layout, bool SWAP>
+static bool decodeBinaryVertices(plyReader& reader, vertex** vertexList, int start, int count) {
+	for (int i = start; i < start + count; i++) {
+		const char* record = reader.take(Layout::recordSize);
+		if (record == NULL) {
+			return false;
+		}
+		glm::vec3& position = vertexList[i]->position;
+		loadBytes(&position.x, record, 4, SWAP);
+		loadBytes(&position.y, record + 4, 4, SWAP);
+		loadBytes(&position.z, record + 8, 4, SWAP);
+	}
+	return true;
+}
+
+template <class Layout>
+static bool decodeVertices(plyReader& reader, plyEncoding format, vertex** vertexList, int start, int count) {
+	if (format == PLY_ASCII) {
+		return decodeAsciiVertices<Layout>(reader, vertexList, start, count);
+	}
+	if ((format == PLY_BINARY_LITTLE_ENDIAN) == hostIsLittleEndian()) {
+		return decodeBinaryVertices<Layout, false>(reader, vertexList, start, count);
+	}
+	return decodeBinaryVertices<Layout, true>(reader, vertexList, start, count);
+}
+
+// true if the element's properties are exactly names, in order, all scalars of type
+static bool matches(const plyElement& element, int first, const char* const* names, int nameCount, plyType type) {
+	if ((int)element.properties.size() < first + nameCount) {
+		return false;
+	}
+	for (int i = 0; i < nameCount; i++) {
+		const plyProperty& property = element.properties[first + i];
+		if (property.isList || property.type != type || property.name != names[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*  ===============================================
+	  Desc: Decoder for any vertex layout: reads each property according
+	  to the schema and keeps x, y and z wherever they are
+	=============================================== */
+static bool decodeGenericVertices(plyReader& reader, plyEncoding format, const plyElement& element, vertex** vertexList, int start, int count) {
+	int axis[3] = { element.findProperty("x"), element.findProperty("y"), element.findProperty("z") };
+	for (int i = start; i < start + count; i++) {
+		glm::vec3& position = vertexList[i]->position;
+		for (int p = 0; p < (int)element.properties.size(); p++) {
+			const plyProperty& property = element.properties[p];
+			double value;
+			if (property.isList) {
+				if (!reader.value(property.countType, format, value)) {
+					return false;
+				}
+				for (int k = 0; k < (int)value; k++) {
+					double skipped;
+					if (!reader.value(property.type, format, skipped)) {
+						return false;
+					}
+				}
+				continue;
+			}
+			if (!reader.value(property.type, format, value)) {
+				return false;
+			}
+			for (int a = 0; a < 3; a++) {
+				if (axis[a] == p) {
+					position[a] = (float)value;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool readVertices(plyReader& reader, const plyHeader& header, const plyElement& element, vertex** vertexList, int start, int count) {
+	static const char* const xyz[] = { "x", "y", "z" };
+	static const char* const confidence[] = { "confidence", "intensity" };
+	static const char* const normal[] = { "nx", "ny", "nz" };
+	static const char* const color[] = { "red", "green", "blue" };
+
+	int size = (int)element.properties.size();
+	if (matches(element, 0, xyz, 3, PLY_FLOAT)) {
+		if (size == 3) {
+			return decodeVertices<layoutXYZ>(reader, header.format, vertexList, start, count);
+		}
+		if (size == 5 && matches(element, 3, confidence, 2, PLY_FLOAT)) {
+			return decodeVertices<layoutXYZConfidence>(reader, header.format, vertexList, start, count);
+		}
+		if (size == 6 && matches(element, 3, normal, 3, PLY_FLOAT)) {
+			return decodeVertices<layoutXYZNormal>(reader, header.format, vertexList, start, count);
+		}
+		if (size == 6 && matches(element, 3, color, 3, PLY_UCHAR)) {
+			return decodeVertices<layoutXYZColor>(reader, header.format, vertexList, start, count);
+		}
+	}
+	return decodeGenericVertices(reader, header.format, element, vertexList, start, count);
+}
+
+// adds the triangle fan of a polygon with count corners to faces
+static void addPolygon(const int* corners, int count, vector<face*>& faces) {
+	for (int k = 1; k + 1 < count; k++) {
+		face* newFace = new face();
+		newFace->vertexList[0] = corners[0];
+		newFace->vertexList[1] = corners[k];
+		newFace->vertexList[2] = corners[k + 1];
+		faces.push_back(newFace);
+	}
+}
+
+bool readFaces(plyReader& reader, const plyHeader& header, const plyElement& element, vector<face*>& faces, long count) {
+	int indices = element.findProperty("vertex_indices");
+	if (indices < 0) {
+		indices = element.findProperty("vertex_index");
+	}
+	vector<int> corners;
+
+	// fast path: the face record is only "list uchar int" in binary,
+	// which is read as one count byte followed by the indices
+	bool binary = header.format != PLY_ASCII;
+	bool swap = binary && (header.format == PLY_BINARY_LITTLE_ENDIAN) != hostIsLittleEndian();
+	if (binary && element.properties.size() == 1 && indices == 0
+		&& element.properties[0].countType == PLY_UCHAR
+		&& (element.properties[0].type == PLY_INT || element.properties[0].type == PLY_UINT)) {
+		for (long i = 0; i < count; i++) {
+			const char* countByte = reader.take(1);
+			if (countByte == NULL) {
+				return false;
+			}
+			int cornerCount = (unsigned char)*countByte;
+			const char* record = reader.take(cornerCount * 4);
+			if (record == NULL) {
+				return false;
+			}
+			corners.resize(cornerCount);
+			for (int k = 0; k < cornerCount; k++) {
+				loadBytes(&corners[k], record + 4 * k, 4, swap);
+			}
+			addPolygon(cornerCount ? &corners[0] : NULL, cornerCount, faces);
+		}
+		return true;
+	}
+
+	// ascii fast path: same record, but as text
+	if (!binary && element.properties.size() == 1 && indices == 0) {
+		for (long i = 0; i < count; i++) {
+			int cornerCount;
+			if (!reader.asciiInt(cornerCount) || cornerCount < 0) {
+				return false;
+			}
+			corners.resize(cornerCount);
+			for (int k = 0; k < cornerCount; k++) {
+				if (!reader.asciiInt(corners[k])) {
+					return false;
+				}
+			}
+			addPolygon(cornerCount ? &corners[0] : NULL, cornerCount, faces);
+		}
+		return true;
+	}
+
+	// any other layout, e.g. extra per-face properties
+	for (long i = 0; i < count; i++) {
+		corners.clear();
+		for (int p = 0; p < (int)element.properties.size(); p++) {
+			const plyProperty& property = element.properties[p];
+			double value;
+			if (!property.isList) {
+				if (!reader.value(property.type, header.format, value)) {
+					return false;
+				}
+				continue;
+			}
+			if (!reader.value(property.countType, header.format, value)) {
+				return false;
+			}
+			int listCount = (int)value;
+			for (int k = 0; k < listCount; k++) {
+				if (!reader.value(property.type, header.format, value)) {
+					return false;
+				}
+				if (p == indices) {
+					corners.push_back((int)value);
+				}
+			}
+		}
+		addPolygon(corners.empty() ? NULL : &corners[0], (int)corners.size(), faces);
+	}
+	return true;
+}
+
+bool skipElement(plyReader& reader, const plyHeader& header, const plyElement& element) {
+	for (long i = 0; i < element.count; i++) {
+		for (int p = 0; p < (int)element.properties.size(); p++) {
+			const plyProperty& property = element.properties[p];
+			double value;
+			if (!property.isList) {
+				if (!reader.value(property.type, header.format, value)) {
+					return false;
+				}
+				continue;
+			}
+			if (!reader.value(property.countType, header.format, value)) {
+				return false;
+			}
+			for (int k = 0; k < (int)value; k++) {
+				double skipped;
+				if (!reader.value(property.type, header.format, skipped)) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
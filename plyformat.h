@@ -0,0 +1,129 @@
+/*  =================== File Information =================
+        File Name: plyformat.h
+        Description: PLY header schema, buffered reader and element decoders
+
+        Purpose:        Parse the header into elements and properties and
+                        decode vertex/face data in any valid layout
+                        (ascii, binary_little_endian, binary_big_endian)
+        Examples:       See ply::loadGeometry
+        ===================================================== */
+#ifndef PLYFORMAT_H
+#define PLYFORMAT_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "geometry.h"
+
+using namespace std;
+
+enum plyType { PLY_CHAR, PLY_UCHAR, PLY_SHORT, PLY_USHORT, PLY_INT, PLY_UINT, PLY_FLOAT, PLY_DOUBLE, PLY_INVALID };
+enum plyEncoding { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN, PLY_BINARY_BIG_ENDIAN };
+
+/*  ============== plyProperty ==============
+        Purpose: One "property" line of the header
+        A list property has a count of countType followed by that many
+        values of type, e.g. "property list uchar int vertex_indices"
+        ==================================== */
+struct plyProperty {
+        string name;
+        plyType type;
+        bool isList;
+        plyType countType;
+};
+
+/*  ============== plyElement ==============
+        Purpose: One "element" line of the header and its properties,
+        in the order they appear in each record
+        ==================================== */
+struct plyElement {
+        string name;
+        long count;
+        vector<plyProperty> properties;
+
+        // index of the property called name, or -1
+        int findProperty(const string& propertyName) const;
+};
+
+/*  ============== plyHeader ==============
+        Purpose: Everything between "ply" and "end_header"
+        ==================================== */
+struct plyHeader {
+        plyEncoding format;
+        vector<plyElement> elements;
+        // bytes from the start of the file to the first record
+        long headerBytes;
+
+        int findElement(const string& elementName) const;
+        int propertyCount() const;
+        // the fewest bytes a binary file's records can take (every list
+        // empty), to catch counts the file cannot possibly hold
+        double minimumDataBytes() const;
+};
+
+/*  ============== plyReader ==============
+        Purpose: Reads a PLY stream through a large buffer, so ascii tokens
+        and binary records are parsed straight out of memory instead of
+        through getline and a copy per line.
+        ==================================== */
+class plyReader {
+public:
+        plyReader(istream& _in);
+
+        /*      ===============================================
+                Desc: Parses the header. On failure returns false and
+                describes the problem in error.
+        =============================================== */
+        bool readHeader(plyHeader& header, string& error);
+
+        // ascii values, separated by any whitespace
+        bool asciiFloat(float& value);
+        bool asciiInt(int& value);
+        bool asciiSkip();
+
+        /*      ===============================================
+                Desc: Returns a pointer to the next size bytes of a binary
+                record (valid until the next read), or NULL at end of file
+        =============================================== */
+        const char* take(size_t size);
+
+        // reads one value of any type in the given encoding
+        bool value(plyType type, plyEncoding format, double& result);
+
+private:
+        bool fill(size_t need);
+        bool readLine(string& line);
+        bool skipSpace();
+
+        istream& in;
+        vector<char> buffer;
+        size_t pos;
+        size_t end;
+        bool eof;
+        // bytes consumed by readLine so far
+        long lineBytes;
+};
+
+/*  ===============================================
+        Desc: Decoders for the vertex and face elements
+
+        readVertices fills vertexList[start, start + count) with the next
+        count records of the vertex element. The common layouts (xyz,
+        xyz + confidence + intensity, xyz + normal, xyz + rgb) go through
+        decoders specialized at compile time for their fixed record shape;
+        any other layout goes through a generic decoder that follows the
+        schema property by property.
+
+        readFaces appends the next count records of the face element to
+        faces. Polygons with more than three vertices are split into a
+        fan of triangles.
+
+        skipElement reads past every record of an element that is not used.
+        All return false if the file ends early.
+        =============================================== */
+bool readVertices(plyReader& reader, const plyHeader& header, const plyElement& element, vertex** vertexList, int start, int count);
+bool readFaces(plyReader& reader, const plyHeader& header, const plyElement& element, vector<face*>& faces, long count);
+bool skipElement(plyReader& reader, const plyHeader& header, const plyElement& element);
+
+#endif
@@ -0,0 +1,538 @@
+/*  =================== File Information =================
+    File Name: plygen.cpp
+    Description: Synthetic .ply generator for scaling and stress tests
+
+    Purpose: Writes valid ascii or binary .ply meshes of any size (1k to
+             100M+ triangles) without holding them in memory: vertices and
+             faces are computed from their grid position and streamed out
+             in 1 MB blocks. With -w it writes a size sweep, and with -b
+             it loads every file it writes and prints the per-stage load
+             timing (ply::getLoadTiming) as one CSV row per size, so the
+             rows can be plotted directly as scaling curves.
+    Shapes:  sphere       closed latitude/longitude subdivided sphere
+             terrain      noisy height field grid (open, one boundary loop)
+             holes        sphere with slots cut out of it (many boundaries)
+             nonmanifold  sphere with fins on shared edges (edges with
+                          three faces) and spikes that touch it at a
+                          single vertex
+    Usage:   plygen [-t shape] [-n triangles] [-a] [-s seed] [-o file]
+                    [-w max] [-f factor] [-d outdir] [-b] [-r] [-j threads]
+             -t  shape to generate (default: sphere)
+             -n  target triangle count; the real count is the nearest one
+                 the shape can make (default: 1000)
+             -a  write ascii instead of binary
+             -s  seed for the terrain noise and the hole/fin placement
+             -o  output file (default: <shape>_<triangles>.ply in outdir)
+             -w  write a sweep from -n up to max triangles
+             -f  size factor between sweep steps (default: 10)
+             -d  directory for the generated files (default: .)
+             -b  load each file after writing it and print CSV timings
+             -r  remove each file once it has been loaded (with -b)
+             -j  number of threads the loader uses (default: all cores)
+    ===================================================== */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "parallel.h"
+#include "ply.h"
+
+using namespace std;
+
+#define PI 3.14159265358979323846
+
+enum shapeType { SHAPE_SPHERE, SHAPE_TERRAIN, SHAPE_HOLES, SHAPE_NONMANIFOLD };
+
+static const char *shapeNames[] = { "sphere", "terrain", "holes", "nonmanifold" };
+
+// Slots of the holes shape: every HOLE_ROW_SPACING-th band of the sphere
+// has slots HOLE_SLOT_WIDTH quads wide cut out of it. Bands in between are
+// kept whole, so every vertex is still used and each slot is its own
+// boundary loop.
+#define HOLE_ROW_SPACING 4
+#define HOLE_SLOT_WIDTH  8
+
+// Fins and spikes of the nonmanifold shape sit on every FIN_SPACING-th
+// band and meridian
+#define FIN_SPACING 4
+
+/*  ============== meshShape ==============
+        Purpose: Everything needed to stream one generated mesh
+
+        The sphere shapes are segments x rings: a pole vertex at each end
+        and rings - 1 rings of segments vertices in between. The terrain is
+        a grid of segments x segments quads.
+        ==================================== */
+struct meshShape {
+    shapeType    type;
+    int          segments;
+    int          rings;
+    unsigned int seed;
+    long         vertexCount;
+    long         faceCount;
+};
+
+
+/*  ============== plyStreamWriter ==============
+        Purpose: Writes the header and then vertex and face records
+        through a 1 MB block, in the same layout ply::writeBinary uses
+        (float x y z, uchar int list) or the equivalent ascii
+        ==================================== */
+class plyStreamWriter {
+public:
+    plyStreamWriter(ostream &_out, bool _ascii) : out(_out), ascii(_ascii) {
+        block.reserve(BLOCK_SIZE + 256);
+    }
+
+    ~plyStreamWriter() { flush(); }
+
+    void header(long vertexCount, long faceCount) {
+        unsigned int one = 1;
+        bool littleEndian = *(unsigned char *)&one == 1;
+
+        out << "ply\n";
+        if (ascii) {
+            out << "format ascii 1.0\n";
+        }
+        else {
+            out << "format " << (littleEndian ? "binary_little_endian" : "binary_big_endian") << " 1.0\n";
+        }
+        out << "comment generated by plygen\n";
+        out << "element vertex " << vertexCount << "\n";
+        out << "property float x\nproperty float y\nproperty float z\n";
+        out << "element face " << faceCount << "\n";
+        out << "property list uchar int vertex_indices\n";
+        out << "end_header\n";
+    }
+
+    void vertex(float x, float y, float z) {
+        if (ascii) {
+            char text[64];
+            int  length = snprintf(text, sizeof(text), "%.7g %.7g %.7g\n", x, y, z);
+            block.insert(block.end(), text, text + length);
+        }
+        else {
+            float values[3] = { x, y, z };
+            block.insert(block.end(), (const char *)values, (const char *)values + sizeof(values));
+        }
+        if (block.size() >= BLOCK_SIZE) {
+            flush();
+        }
+    }
+
+    void face(long a, long b, long c) {
+        if (ascii) {
+            char text[64];
+            int  length = snprintf(text, sizeof(text), "3 %ld %ld %ld\n", a, b, c);
+            block.insert(block.end(), text, text + length);
+        }
+        else {
+            int indices[3] = { (int)a, (int)b, (int)c };
+            block.push_back((char)3);
+            block.insert(block.end(), (const char *)indices, (const char *)indices + sizeof(indices));
+        }
+        if (block.size() >= BLOCK_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (!block.empty()) {
+            out.write(&block[0], block.size());
+            block.clear();
+        }
+    }
+
+private:
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    ostream     &out;
+    bool         ascii;
+    vector<char> block;
+};
+
+
+/*  ===============================================
+        Desc: Hash and value noise for the terrain and for placing holes
+        and fins. All integer, so a seed always gives the same file.
+        =============================================== */
+static unsigned int hash3(unsigned int x, unsigned int y, unsigned int seed) {
+    unsigned int h = seed * 0x9e3779b9u;
+    h ^= x * 0x85ebca6bu;
+    h = (h << 13) | (h >> 19);
+    h ^= y * 0xc2b2ae35u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static float lattice(int x, int y, unsigned int seed) {
+    return (hash3((unsigned int)x, (unsigned int)y, seed) & 0xffffff) / (float)0xffffff * 2.0f - 1.0f;
+}
+
+static float valueNoise(float x, float y, unsigned int seed) {
+    int   ix = (int)floor(x), iy = (int)floor(y);
+    float fx = x - ix, fy = y - iy;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    float top    = lattice(ix, iy, seed) + (lattice(ix + 1, iy, seed) - lattice(ix, iy, seed)) * fx;
+    float bottom = lattice(ix, iy + 1, seed) + (lattice(ix + 1, iy + 1, seed) - lattice(ix, iy + 1, seed)) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// Five octaves of value noise, about -1..1
+static float terrainHeight(float x, float y, unsigned int seed) {
+    float height = 0.0f, amplitude = 0.5f, frequency = 4.0f;
+    for (int octave = 0; octave < 5; octave++) {
+        height += amplitude * valueNoise(x * frequency, y * frequency, seed + octave);
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return height;
+}
+
+
+/*  ===============================================
+        Desc: Sphere layout. Ring r (1..rings-1) starts at vertex
+        1 + (r - 1) * segments; vertex 0 is the north pole and the last
+        vertex the south pole.
+        =============================================== */
+static long ringVertex(const meshShape &shape, int ring, int segment) {
+    return 1 + (long)(ring - 1) * shape.segments + segment % shape.segments;
+}
+
+static bool isHoleBand(const meshShape &shape, int ring) {
+    return shape.type == SHAPE_HOLES && ring % HOLE_ROW_SPACING == HOLE_ROW_SPACING / 2
+        && ring + 1 < shape.rings;
+}
+
+// True if the quad below ring r at segment s is cut out of the holes
+// shape. The last quad of every slot is kept so slots never join up.
+static bool isHole(const meshShape &shape, int ring, int segment) {
+    if (!isHoleBand(shape, ring) || segment % HOLE_SLOT_WIDTH == HOLE_SLOT_WIDTH - 1) {
+        return false;
+    }
+    return hash3(ring, segment / HOLE_SLOT_WIDTH, shape.seed) % 3 == 0;
+}
+
+static int finCount(const meshShape &shape) {
+    if (shape.type != SHAPE_NONMANIFOLD) {
+        return 0;
+    }
+    int bands = 0;
+    for (int ring = 1; ring + 1 < shape.rings; ring++) {
+        if (ring % FIN_SPACING == 1) {
+            bands++;
+        }
+    }
+    return bands * ((shape.segments + FIN_SPACING - 1) / FIN_SPACING);
+}
+
+/*  ===============================================
+        Desc: Picks the grid size that comes closest to triangles and
+        counts the vertices and faces that will be written
+        =============================================== */
+static meshShape makeShape(shapeType type, long triangles, unsigned int seed) {
+    meshShape shape;
+    shape.type = type;
+    shape.seed = seed;
+
+    if (type == SHAPE_TERRAIN) {
+        shape.segments = max(1, (int)floor(sqrt(triangles / 2.0) + 0.5));
+        shape.rings = shape.segments;
+        shape.vertexCount = (long)(shape.segments + 1) * (shape.segments + 1);
+        shape.faceCount = 2L * shape.segments * shape.segments;
+        return shape;
+    }
+
+    // 2 * segments * (rings - 1) triangles, with rings about segments / 2
+    shape.segments = max(3, (int)floor(sqrt((double)triangles) + 0.5));
+    shape.rings = max(2, (int)floor(triangles / (2.0 * shape.segments) + 0.5) + 1);
+    shape.vertexCount = 2 + (long)(shape.rings - 1) * shape.segments;
+    shape.faceCount = 2L * shape.segments * (shape.rings - 1);
+
+    for (int ring = 1; ring + 1 < shape.rings; ring++) {
+        if (isHoleBand(shape, ring)) {
+            for (int segment = 0; segment < shape.segments; segment++) {
+                if (isHole(shape, ring, segment)) {
+                    shape.faceCount -= 2;
+                }
+            }
+        }
+    }
+
+    // every fin adds one vertex and one face, every spike two and one
+    long fins = finCount(shape);
+    shape.vertexCount += 3 * fins;
+    shape.faceCount += 2 * fins;
+    return shape;
+}
+
+static void writeTerrain(const meshShape &shape, plyStreamWriter &writer) {
+    int size = shape.segments;
+    for (int row = 0; row <= size; row++) {
+        for (int column = 0; column <= size; column++) {
+            float x = column / (float)size, z = row / (float)size;
+            writer.vertex(x * 2.0f - 1.0f, 0.25f * terrainHeight(x, z, shape.seed), z * 2.0f - 1.0f);
+        }
+    }
+    for (int row = 0; row < size; row++) {
+        for (int column = 0; column < size; column++) {
+            long a = (long)row * (size + 1) + column;
+            long b = a + size + 1;
+            writer.face(a, b, a + 1);
+            writer.face(a + 1, b, b + 1);
+        }
+    }
+}
+
+static void writeSphere(const meshShape &shape, plyStreamWriter &writer) {
+    int segments = shape.segments, rings = shape.rings;
+
+    writer.vertex(0.0f, 1.0f, 0.0f);
+    for (int ring = 1; ring < rings; ring++) {
+        double latitude = PI * ring / rings;
+        for (int segment = 0; segment < segments; segment++) {
+            double longitude = 2.0 * PI * segment / segments;
+            writer.vertex((float)(sin(latitude) * cos(longitude)), (float)cos(latitude),
+                          (float)(sin(latitude) * sin(longitude)));
+        }
+    }
+    long southPole = ringVertex(shape, rings, 0);
+    writer.vertex(0.0f, -1.0f, 0.0f);
+
+    // fins stand out from the middle of a meridian edge, spikes start
+    // at a single ring vertex; both use the vertices after the south pole
+    long extra = southPole + 1;
+    for (int ring = 1; ring + 1 < rings && shape.type == SHAPE_NONMANIFOLD; ring++) {
+        if (ring % FIN_SPACING != 1) {
+            continue;
+        }
+        for (int segment = 0; segment < segments; segment += FIN_SPACING) {
+            double latitude = PI * (ring + 0.5) / rings;
+            double longitude = 2.0 * PI * segment / segments;
+            glm::vec3 out((float)(sin(latitude) * cos(longitude)), (float)cos(latitude),
+                          (float)(sin(latitude) * sin(longitude)));
+            glm::vec3 fin = out * 1.05f;
+            writer.vertex(fin.x, fin.y, fin.z);
+
+            double spikeLongitude = 2.0 * PI * (segment + 2) / segments;
+            double spikeLatitude = PI * ring / rings;
+            glm::vec3 base((float)(sin(spikeLatitude) * cos(spikeLongitude)), (float)cos(spikeLatitude),
+                           (float)(sin(spikeLatitude) * sin(spikeLongitude)));
+            glm::vec3 side(-(float)sin(spikeLongitude), 0.0f, (float)cos(spikeLongitude));
+            glm::vec3 tipA = base * 1.08f + side * (0.5f / segments);
+            glm::vec3 tipB = base * 1.08f - side * (0.5f / segments);
+            writer.vertex(tipA.x, tipA.y, tipA.z);
+            writer.vertex(tipB.x, tipB.y, tipB.z);
+        }
+    }
+
+    for (int segment = 0; segment < segments; segment++) {
+        writer.face(0, ringVertex(shape, 1, segment + 1), ringVertex(shape, 1, segment));
+    }
+    for (int ring = 1; ring + 1 < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            if (isHole(shape, ring, segment)) {
+                continue;
+            }
+            long a = ringVertex(shape, ring, segment), b = ringVertex(shape, ring, segment + 1);
+            long c = ringVertex(shape, ring + 1, segment), d = ringVertex(shape, ring + 1, segment + 1);
+            writer.face(a, b, c);
+            writer.face(b, d, c);
+        }
+    }
+    for (int segment = 0; segment < segments; segment++) {
+        writer.face(southPole, ringVertex(shape, rings - 1, segment), ringVertex(shape, rings - 1, segment + 1));
+    }
+
+    for (int ring = 1; ring + 1 < rings && shape.type == SHAPE_NONMANIFOLD; ring++) {
+        if (ring % FIN_SPACING != 1) {
+            continue;
+        }
+        for (int segment = 0; segment < segments; segment += FIN_SPACING) {
+            // the meridian edge already has a face on each side, so the
+            // fin makes it a three-face edge
+            writer.face(ringVertex(shape, ring, segment), ringVertex(shape, ring + 1, segment), extra);
+            // the spike shares only one vertex with the sphere
+            writer.face(ringVertex(shape, ring, segment + 2), extra + 1, extra + 2);
+            extra += 3;
+        }
+    }
+}
+
+/*  ===============================================
+        Desc: Writes shape to path. Returns false if the file could not
+        be written.
+        =============================================== */
+static bool writeShape(const meshShape &shape, const string &path, bool ascii) {
+    ofstream out(path.c_str(), ios::out | ios::binary);
+    if (!out.is_open()) {
+        cerr << "cannot write file " << path << endl;
+        return false;
+    }
+
+    {
+        plyStreamWriter writer(out, ascii);
+        writer.header(shape.vertexCount, shape.faceCount);
+        if (shape.type == SHAPE_TERRAIN) {
+            writeTerrain(shape, writer);
+        }
+        else {
+            writeSphere(shape, writer);
+        }
+    }
+    return out.good();
+}
+
+static double fileBytes(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (double)info.st_size : 0.0;
+}
+
+static void usage() {
+    cout << "usage: plygen [-t sphere|terrain|holes|nonmanifold] [-n triangles] [-a] [-s seed] [-o file]" << endl
+         << "              [-w max] [-f factor] [-d outdir] [-b] [-r] [-j threads]" << endl;
+}
+
+
+/**************************************** main() ********************/
+int main(int argc, char **argv) {
+    shapeType    type = SHAPE_SPHERE;
+    long         triangles = 1000;
+    long         sweepMax = 0;
+    double       factor = 10.0;
+    bool         ascii = false;
+    bool         benchmark = false;
+    bool         removeFiles = false;
+    unsigned int seed = 1;
+    string       outPath;
+    string       outDir = ".";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            string name = argv[++i];
+            int    found = -1;
+            for (int s = 0; s < 4; s++) {
+                if (name == shapeNames[s]) {
+                    found = s;
+                }
+            }
+            if (found < 0) {
+                usage();
+                return 1;
+            }
+            type = (shapeType)found;
+        }
+        else if (arg == "-n" && i + 1 < argc) {
+            triangles = (long)atof(argv[++i]);
+        }
+        else if (arg == "-w" && i + 1 < argc) {
+            sweepMax = (long)atof(argv[++i]);
+        }
+        else if (arg == "-f" && i + 1 < argc) {
+            factor = atof(argv[++i]);
+        }
+        else if (arg == "-s" && i + 1 < argc) {
+            seed = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+        else if (arg == "-d" && i + 1 < argc) {
+            outDir = argv[++i];
+        }
+        else if (arg == "-j" && i + 1 < argc) {
+            setThreadCount(atoi(argv[++i]));
+        }
+        else if (arg == "-a") {
+            ascii = true;
+        }
+        else if (arg == "-b") {
+            benchmark = true;
+        }
+        else if (arg == "-r") {
+            removeFiles = true;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    // indices are written as int, so faces and vertices must stay in range
+    if (triangles < 1 || triangles > 2000000000L || sweepMax > 2000000000L || factor <= 1.0) {
+        usage();
+        return 1;
+    }
+
+    vector<long> sizes;
+    sizes.push_back(triangles);
+    while (sweepMax > 0 && sizes.back() * factor <= sweepMax * 1.0001) {
+        sizes.push_back((long)(sizes.back() * factor + 0.5));
+    }
+    if (!outPath.empty() && sizes.size() > 1) {
+        cerr << "-o names a single file; use -d for a sweep" << endl;
+        return 1;
+    }
+
+    if (benchmark) {
+        cout << "shape,format,triangles,vertices,edges,MB,write_ms,load_ms,parse_ms,bounds_ms,faces_ms,"
+                "pipeline_ms,rescale_ms,edges_ms,bvh_ms,faces_per_s,MB_per_s"
+             << endl;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        meshShape shape = makeShape(type, sizes[i], seed);
+        string    path = outPath;
+        if (path.empty()) {
+            path = outDir + "/" + shapeNames[type] + "_" + to_string(shape.faceCount) + (ascii ? "_ascii" : "") + ".ply";
+        }
+
+        chrono::steady_clock::time_point writeStart = chrono::steady_clock::now();
+        if (!writeShape(shape, path, ascii)) {
+            failed++;
+            continue;
+        }
+        double writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+        double megabytes = fileBytes(path) / (1024.0 * 1024.0);
+
+        if (!benchmark) {
+            cout << path << ": " << shape.vertexCount << " vertices, " << shape.faceCount << " faces, "
+                 << megabytes << " MB in " << writeSeconds * 1000.0 << " ms" << endl;
+            continue;
+        }
+
+        ply mesh;
+        if (!mesh.reload(path)) {
+            failed++;
+        }
+        else {
+            loadTiming timing = mesh.getLoadTiming();
+            cout << shapeNames[type] << "," << (ascii ? "ascii" : "binary") << "," << mesh.getFaceCount() << ","
+                 << mesh.getVertexCount() << "," << mesh.getEdgeCount() << "," << megabytes << ","
+                 << writeSeconds * 1000.0 << "," << timing.total * 1000.0 << "," << timing.parse * 1000.0 << ","
+                 << timing.bounds * 1000.0 << "," << timing.faces * 1000.0 << "," << timing.pipeline * 1000.0 << ","
+                 << timing.rescale * 1000.0 << "," << timing.edges * 1000.0 << "," << timing.bvh * 1000.0 << ","
+                 << mesh.getFaceCount() / timing.total << "," << megabytes / timing.total << endl;
+        }
+        if (removeFiles) {
+            remove(path.c_str());
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+/*  =================== File Information =================
+  File Name: plystream.cpp
+  Description: Compressed .ply input, decoded on a producer thread
+  ===================================================== */
+#include <cstring>
+#include <iostream>
+#include "plystream.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+// compressed bytes read from the file at a time, and the size and number
+// of decompressed blocks the producer may run ahead of the parser
+static const size_t INPUT_BLOCK = 1 << 20;
+static const size_t OUTPUT_BLOCK = 1 << 20;
+static const int OUTPUT_BLOCKS = 4;
+
+static bool endsWith(const string& text, const string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+plyCompression detectCompression(const string& path) {
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	unsigned char magic[4] = { 0, 0, 0, 0 };
+	if (file.read((char*)magic, 4) || file.gcount() >= 2) {
+		if (magic[0] == 0x1f && magic[1] == 0x8b) {
+			return PLY_GZIP;
+		}
+		if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+			return PLY_ZSTD;
+		}
+		return PLY_UNCOMPRESSED;
+	}
+	if (endsWith(path, ".gz")) {
+		return PLY_GZIP;
+	}
+	if (endsWith(path, ".zst")) {
+		return PLY_ZSTD;
+	}
+	return PLY_UNCOMPRESSED;
+}
+
+string stripCompressionExtension(const string& path) {
+	if (endsWith(path, ".gz")) {
+		return path.substr(0, path.size() - 3);
+	}
+	if (endsWith(path, ".zst")) {
+		return path.substr(0, path.size() - 4);
+	}
+	return path;
+}
+
+decompressBuffer::decompressBuffer(const string& _path, plyCompression _compression)
+	: path(_path), compression(_compression) {
+	inputPos = 0;
+	inputEnd = 0;
+	inputDone = false;
+	codec = NULL;
+	codecEnded = false;
+	frameOpen = false;
+	failed = false;
+	filled = 0;
+	released = 0;
+	holding = false;
+	finished = false;
+	stopping = false;
+	setg(NULL, NULL, NULL);
+
+	file.open(path.c_str(), ios::in | ios::binary);
+	opened = file.is_open();
+	if (!opened) {
+		cout << "cannot open file " << path << "\n";
+		return;
+	}
+
+	if (compression == PLY_GZIP) {
+#ifdef HAVE_ZLIB
+		z_stream* z = new z_stream;
+		memset(z, 0, sizeof(z_stream));
+		// 15 window bits, + 16 for a gzip header
+		if (inflateInit2(z, 15 + 16) == Z_OK) {
+			codec = z;
+		}
+		else {
+			delete z;
+		}
+#else
+		cout << "cannot read " << path << ": built without gzip support (make ZLIB=1)\n";
+#endif
+	}
+	else if (compression == PLY_ZSTD) {
+#ifdef HAVE_ZSTD
+		codec = ZSTD_createDStream();
+		if (codec != NULL) {
+			ZSTD_initDStream((ZSTD_DStream*)codec);
+		}
+#else
+		cout << "cannot read " << path << ": built without zstd support (install libzstd and rebuild, or make ZSTD=1)\n";
+#endif
+	}
+	if (codec == NULL) {
+		opened = false;
+		return;
+	}
+
+	input.resize(INPUT_BLOCK);
+	blocks.assign(OUTPUT_BLOCKS, vector<char>(OUTPUT_BLOCK));
+	blockSizes.assign(OUTPUT_BLOCKS, 0);
+	producer = thread(&decompressBuffer::produce, this);
+}
+
+decompressBuffer::~decompressBuffer() {
+	{
+		lock_guard<mutex> lock(ringLock);
+		stopping = true;
+	}
+	ringChanged.notify_all();
+	if (producer.joinable()) {
+		producer.join();
+	}
+
+	if (codec != NULL) {
+#ifdef HAVE_ZLIB
+		if (compression == PLY_GZIP) {
+			inflateEnd((z_stream*)codec);
+			delete (z_stream*)codec;
+		}
+#endif
+#ifdef HAVE_ZSTD
+		if (compression == PLY_ZSTD) {
+			ZSTD_freeDStream((ZSTD_DStream*)codec);
+		}
+#endif
+	}
+}
+
+void decompressBuffer::fail(const string& message) {
+	cout << "cannot decompress " << path << ": " << message << "\n";
+	failed = true;
+}
+
+bool decompressBuffer::readInput() {
+	file.read(&input[0], input.size());
+	inputPos = 0;
+	inputEnd = (size_t)file.gcount();
+	if (inputEnd == 0) {
+		inputDone = true;
+	}
+	return inputEnd > 0;
+}
+
+/*  ===============================================
+	  Desc: Runs until every block is decoded or the reader goes away.
+	  A block shorter than OUTPUT_BLOCK is the last one.
+	=============================================== */
+void decompressBuffer::produce() {
+	while (true) {
+		int index;
+		{
+			unique_lock<mutex> lock(ringLock);
+			ringChanged.wait(lock, [&]() { return stopping || filled - released < (long)blocks.size(); });
+			if (stopping) {
+				return;
+			}
+			index = (int)(filled % (long)blocks.size());
+		}
+
+		// the reader never touches a block between released and filled
+		size_t size = decode(&blocks[index][0], OUTPUT_BLOCK);
+		bool last = size < OUTPUT_BLOCK;
+		{
+			lock_guard<mutex> lock(ringLock);
+			blockSizes[index] = size;
+			filled++;
+			finished = last;
+		}
+		ringChanged.notify_all();
+		if (last) {
+			return;
+		}
+	}
+}
+
+/*  ===============================================
+	  Desc: A gzip member or zstd frame that is still open when the
+	  input runs out, and the decoder can make no more progress, means
+	  the file was cut short. After a member or frame ends the decoder
+	  is reset, so the next one (if any) follows on.
+	=============================================== */
+size_t decompressBuffer::decode(char* out, size_t capacity) {
+	size_t produced = 0;
+	while (produced < capacity && !failed && !codecEnded) {
+		if (inputPos == inputEnd && !inputDone) {
+			readInput();
+		}
+		if (inputPos == inputEnd && inputDone && !frameOpen) {
+			codecEnded = true;
+			break;
+		}
+
+		size_t before = produced;
+#ifdef HAVE_ZLIB
+		if (compression == PLY_GZIP) {
+			z_stream* z = (z_stream*)codec;
+			z->next_in = (Bytef*)&input[inputPos];
+			z->avail_in = (uInt)(inputEnd - inputPos);
+			z->next_out = (Bytef*)out + produced;
+			z->avail_out = (uInt)(capacity - produced);
+			int result = inflate(z, Z_NO_FLUSH);
+			inputPos = inputEnd - z->avail_in;
+			produced = capacity - z->avail_out;
+			if (result == Z_STREAM_END) {
+				frameOpen = false;
+				inflateReset(z);
+				continue;
+			}
+			if (result != Z_OK && result != Z_BUF_ERROR) {
+				fail(z->msg != NULL ? z->msg : "corrupt data");
+				break;
+			}
+			frameOpen = true;
+		}
+#endif
+#ifdef HAVE_ZSTD
+		if (compression == PLY_ZSTD) {
+			ZSTD_inBuffer in = { &input[0] + inputPos, inputEnd - inputPos, 0 };
+			ZSTD_outBuffer output = { out, capacity, produced };
+			size_t result = ZSTD_decompressStream((ZSTD_DStream*)codec, &output, &in);
+			inputPos += in.pos;
+			produced = output.pos;
+			if (ZSTD_isError(result)) {
+				fail(ZSTD_getErrorName(result));
+				break;
+			}
+			// 0 once a frame is decoded and flushed
+			frameOpen = result != 0;
+		}
+#endif
+		if (produced == before && inputPos == inputEnd && inputDone && frameOpen) {
+			fail("file ends early");
+		}
+	}
+	return produced;
+}
+
+decompressBuffer::int_type decompressBuffer::underflow() {
+	if (gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	unique_lock<mutex> lock(ringLock);
+	while (true) {
+		if (holding) {
+			released++;
+			holding = false;
+			ringChanged.notify_all();
+		}
+		ringChanged.wait(lock, [&]() { return filled > released || finished; });
+		if (filled == released) {
+			setg(NULL, NULL, NULL);
+			return traits_type::eof();
+		}
+		int index = (int)(released % (long)blocks.size());
+		holding = true;
+		if (blockSizes[index] > 0) {
+			char* base = &blocks[index][0];
+			setg(base, base, base + blockSizes[index]);
+			return traits_type::to_int_type(*base);
+		}
+	}
+}
+
+plyInput::plyInput() {
+	decompressor = NULL;
+	in = NULL;
+	compression = PLY_UNCOMPRESSED;
+	fileBytes = -1;
+}
+
+plyInput::~plyInput() {
+	close();
+}
+
+void plyInput::close() {
+	if (in != &file) {
+		delete in;
+	}
+	in = NULL;
+	delete decompressor;
+	decompressor = NULL;
+	if (file.is_open()) {
+		file.close();
+	}
+}
+
+bool plyInput::open(const string& path) {
+	compression = detectCompression(path);
+	fileBytes = -1;
+	if (compression == PLY_UNCOMPRESSED) {
+		file.open(path.c_str(), ios::in | ios::binary);
+		if (!file.is_open()) {
+			cout << "cannot open file " << path << "\n";
+			return false;
+		}
+		file.seekg(0, ios::end);
+		fileBytes = (long)file.tellg();
+		file.seekg(0, ios::beg);
+		in = &file;
+		return true;
+	}
+
+	decompressor = new decompressBuffer(path, compression);
+	if (!decompressor->isOpen()) {
+		return false;
+	}
+	in = new istream(decompressor);
+	return true;
+}
@@ -0,0 +1,139 @@
+/*  =================== File Information =================
+        File Name: plystream.h
+        Description: Opens .ply files, decompressing .ply.gz and .ply.zst
+                     on the fly
+
+        Purpose:        Load compressed models straight from the archive,
+                        without a decompressed copy on disk or in memory.
+                        Decompression runs on its own thread, a few blocks
+                        ahead of the parser.
+        Build:          gzip needs zlib (HAVE_ZLIB, make ZLIB=1, the
+                        default), zstd needs libzstd (HAVE_ZSTD, on by
+                        default when the Makefile finds libzstd). A file in
+                        a format that was left out
+                        fails to open with a message saying so.
+        Examples:       See example below for using plyInput
+        ===================================================== */
+#ifndef PLYSTREAM_H
+#define PLYSTREAM_H
+
+#include <condition_variable>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+enum plyCompression { PLY_UNCOMPRESSED, PLY_GZIP, PLY_ZSTD };
+
+/*  ===============================================
+        Desc: Compression of the file at path, from its first bytes
+        (1f 8b for gzip, 28 b5 2f fd for zstd) so misnamed files still
+        load; the extension is only used if the file cannot be read
+        =============================================== */
+plyCompression detectCompression(const string& path);
+
+/*  ===============================================
+        Desc: path without a trailing .gz or .zst
+        =============================================== */
+string stripCompressionExtension(const string& path);
+
+/*  ============== decompressBuffer ==============
+        Purpose: A streambuf over the decompressed bytes of a file
+
+        A producer thread reads the compressed file in large blocks and
+        decodes into a small ring of output blocks; underflow() hands the
+        next full block to the reader as its get area, so bytes are never
+        copied again after decoding. The producer waits while the ring is
+        full, so memory stays at a few blocks whatever the file size.
+        Concatenated gzip members and zstd frames are read one after the
+        other, as gunzip and zstd -d do.
+        ==================================== */
+class decompressBuffer : public streambuf {
+public:
+        decompressBuffer(const string& _path, plyCompression _compression);
+        ~decompressBuffer();
+
+        bool isOpen() { return opened; }
+
+protected:
+        int_type underflow();
+
+private:
+        void produce();
+        // fills out with up to capacity decompressed bytes; fewer only
+        // at the end of the data or on an error
+        size_t decode(char* out, size_t capacity);
+        bool readInput();
+        void fail(const string& message);
+
+        string path;
+        plyCompression compression;
+        ifstream file;
+        bool opened;
+
+        // compressed bytes read from file, not yet decoded from inputPos
+        vector<char> input;
+        size_t inputPos;
+        size_t inputEnd;
+        bool inputDone;
+        // decoder state (z_stream or ZSTD_DStream), NULL if not built in
+        void* codec;
+        bool codecEnded;
+        // a gzip member or zstd frame has started and not ended
+        bool frameOpen;
+        bool failed;
+
+        // the ring: block filled % count is written next, block
+        // released % count is the one the reader holds
+        vector<vector<char> > blocks;
+        vector<size_t> blockSizes;
+        long filled;
+        long released;
+        bool holding;
+        bool finished;
+        bool stopping;
+        mutex ringLock;
+        condition_variable ringChanged;
+        thread producer;
+};
+
+/*  ============== plyInput ==============
+        Purpose: The stream loadGeometry parses: the file itself, or a
+        decompressBuffer over it when it is compressed
+
+        Example usage:
+        1.) plyInput input;
+        2.) if (!input.open(filePath)) {...}
+        3.) plyReader reader(input.stream());
+        ==================================== */
+class plyInput {
+public:
+        plyInput();
+        ~plyInput();
+
+        /*      ===============================================
+                Desc: Opens path. Returns false, and prints why, if it
+                cannot be read.
+        =============================================== */
+        bool open(const string& path);
+        // stops the decompression and closes the file
+        void close();
+        istream& stream() { return *in; }
+        plyCompression getCompression() { return compression; }
+        // size of an uncompressed file, -1 for a compressed one
+        long getFileBytes() { return fileBytes; }
+
+private:
+        ifstream file;
+        long fileBytes;
+        decompressBuffer* decompressor;
+        istream* in;
+        plyCompression compression;
+};
+
+#endif
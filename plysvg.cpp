@@ -0,0 +1,120 @@
+/*  =================== File Information =================
+    File Name: plysvg.cpp
+    Description: Command-line silhouette export to SVG
+
+    Purpose: Loads one .ply file and writes its silhouette from many views
+             as .svg files, with the camera of the interactive viewer,
+             without opening a window (see svgexport.h). Views run in
+             parallel on the shared worker pool.
+    Usage:   plysvg [-j threads] [-o outdir] [-t views] [-e tilt] [-p views]
+                    [-s width height] [-w stroke] [-x] <file>
+             -j  number of threads (default: all cores)
+             -o  directory for the .svg files (default: .)
+             -t  turntable of this many views around the vertical axis
+                 (the default, 36 views)
+             -e  tilt of the turntable in degrees (default: 20)
+             -p  this many views spread evenly over a sphere instead
+             -s  picture size in pixels (default: 800 800)
+             -w  line width in pixels (default: 1.5)
+             -x  keep the parts of the silhouette hidden by the mesh
+    ===================================================== */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "parallel.h"
+#include "ply.h"
+#include "plystream.h"
+#include "svgexport.h"
+
+using namespace std;
+
+static string stemName(const string &path) {
+    size_t slash = path.find_last_of('/');
+    string name  = stripCompressionExtension(slash == string::npos ? path : path.substr(slash + 1));
+    size_t dot   = name.find_last_of('.');
+    return dot == string::npos ? name : name.substr(0, dot);
+}
+
+static void usage() {
+    cout << "usage: plysvg [-j threads] [-o outdir] [-t views] [-e tilt] [-p views] [-s width height] [-w stroke] [-x] <file>" << endl;
+}
+
+
+/**************************************** main() ********************/
+int main(int argc, char **argv) {
+    silhouetteExporter exporter;
+    string             path;
+    string             outDir = ".";
+    int                turntable = 36;
+    int                sphere = 0;
+    float              tilt = 20.0f;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            setThreadCount(atoi(argv[++i]));
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            outDir = argv[++i];
+        }
+        else if (arg == "-t" && i + 1 < argc) {
+            turntable = atoi(argv[++i]);
+        }
+        else if (arg == "-e" && i + 1 < argc) {
+            tilt = (float)atof(argv[++i]);
+        }
+        else if (arg == "-p" && i + 1 < argc) {
+            sphere = atoi(argv[++i]);
+        }
+        else if (arg == "-s" && i + 2 < argc) {
+            exporter.width  = atoi(argv[++i]);
+            exporter.height = atoi(argv[++i]);
+        }
+        else if (arg == "-w" && i + 1 < argc) {
+            exporter.strokeWidth = (float)atof(argv[++i]);
+        }
+        else if (arg == "-x") {
+            exporter.hiddenLines = true;
+        }
+        else if (arg[0] == '-' || !path.empty()) {
+            usage();
+            return 1;
+        }
+        else {
+            path = arg;
+        }
+    }
+
+    if (path.empty() || exporter.width <= 0 || exporter.height <= 0) {
+        usage();
+        return 1;
+    }
+
+    ply mesh;
+    if (!mesh.reload(path)) {
+        return 1;
+    }
+    if (!mesh.hasEdges()) {
+        cout << path << ": no edge list (over the memory budget), nothing to export" << endl;
+        return 1;
+    }
+
+    vector<svgView> views;
+    string          prefix = outDir + "/" + stemName(path);
+    if (sphere > 0) {
+        silhouetteExporter::sphereViews(sphere, prefix, views);
+    }
+    else {
+        silhouetteExporter::turntableViews(turntable, tilt, prefix, views);
+    }
+
+    int written = exporter.exportViews(&mesh, views);
+    cout << path << ": " << written << " of " << views.size() << " views, "
+         << exporter.lastSegments << " segments in " << exporter.lastSeconds << " s ("
+         << getThreadCount() << " threads)" << endl;
+
+    return written == (int)views.size() ? 0 : 1;
+}
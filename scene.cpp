@@ -0,0 +1,115 @@
+/*  =================== File Information =================
+  File Name: scene.cpp
+  Description: Draws several meshes, each as many instances
+  ===================================================== */
+#include <iostream>
+#include <FL/gl.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "scene.h"
+
+using namespace std;
+
+scene::scene() {
+}
+
+scene::~scene() {
+	clear();
+}
+
+void scene::clear() {
+	for (int i = 0; i < (int)meshes.size(); i++) {
+		delete meshes[i];
+	}
+	meshes.clear();
+	meshPaths.clear();
+	instances.clear();
+}
+
+int scene::addMesh(string filePath) {
+	for (int i = 0; i < (int)meshPaths.size(); i++) {
+		if (meshPaths[i] == filePath) {
+			return i;
+		}
+	}
+
+	ply* mesh = new ply();
+	mesh->reload(filePath);
+	meshes.push_back(mesh);
+	meshPaths.push_back(filePath);
+	return (int)meshes.size() - 1;
+}
+
+int scene::addInstance(int mesh, glm::mat4 transform, glm::vec3 color) {
+	if (mesh < 0 || mesh >= (int)meshes.size()) {
+		return -1;
+	}
+
+	instance newInstance;
+	newInstance.mesh = mesh;
+	newInstance.transform = transform;
+	newInstance.color = color;
+	instances.push_back(newInstance);
+	return (int)instances.size() - 1;
+}
+
+void scene::addGrid(int mesh, int rows, int cols) {
+	// meshes are scaled to [-0.5, 0.5] by scaleAndCenter, so one cell of
+	// the grid holds one mesh at scale cellSize
+	float cellSize = 2.0f / (float)(rows > cols ? rows : cols);
+
+	for (int r = 0; r < rows; r++) {
+		for (int c = 0; c < cols; c++) {
+			glm::vec3 offset(-1.0f + (c + 0.5f) * cellSize, -1.0f + (r + 0.5f) * cellSize, 0.0f);
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), offset);
+			transform = glm::rotate(transform, glm::radians(15.0f * (r * cols + c)), glm::vec3(0.0f, 1.0f, 0.0f));
+			transform = glm::scale(transform, glm::vec3(cellSize * 0.9f));
+
+			glm::vec3 color(0.3f + 0.7f * (float)c / cols, 0.3f + 0.7f * (float)r / rows, 0.6f);
+			addInstance(mesh, transform, color);
+		}
+	}
+}
+
+/*  ===============================================
+	  Desc: Draws every instance, grouped by mesh so that each mesh's
+	  display list stays hot while its instances are drawn
+	=============================================== */
+void scene::render(bool useColor) {
+	for (int m = 0; m < (int)meshes.size(); m++) {
+		for (int i = 0; i < (int)instances.size(); i++) {
+			if (instances[i].mesh != m) {
+				continue;
+			}
+			if (useColor) {
+				glColor3fv(glm::value_ptr(instances[i].color));
+			}
+			glPushMatrix();
+			glMultMatrixf(glm::value_ptr(instances[i].transform));
+			meshes[m]->renderCached();
+			glPopMatrix();
+		}
+	}
+}
+
+/*  ===============================================
+	  Desc: Computes the front faces of every instance in its object
+	  space and draws the silhouette edges
+	  The look vector of each instance points from the eye to the
+	  instance's origin, which keeps off-center instances correct
+	=============================================== */
+void scene::renderSilhouette(glm::vec3 eyePosition) {
+	for (int i = 0; i < (int)instances.size(); i++) {
+		instance& inst = instances[i];
+		glm::vec3 origin = glm::vec3(inst.transform[3]);
+		glm::mat3 toObject = glm::inverse(glm::mat3(inst.transform));
+		glm::vec3 lookVector = glm::normalize(toObject * (origin - eyePosition));
+
+		meshes[inst.mesh]->computeFrontFace(lookVector, inst.frontFaces);
+
+		glPushMatrix();
+		glMultMatrixf(glm::value_ptr(inst.transform));
+		meshes[inst.mesh]->renderSilhouette(inst.frontFaces);
+		glPopMatrix();
+	}
+}
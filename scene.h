@@ -0,0 +1,89 @@
+/*  =================== File Information =================
+        File Name: scene.h
+        Description: Holds several loaded meshes and many instances of them
+
+        Purpose:        Draw many copies of one or more .ply models at once
+        Examples:       See example below for using scene class
+        ===================================================== */
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== instance ==============
+        Purpose: One placement of a mesh in the scene.
+        The mesh itself is shared, only the transform, colour and the
+        per-face front-facing flags belong to the instance.
+        ==================================== */
+class instance {
+public:
+        int mesh;
+        glm::mat4 transform;
+        glm::vec3 color;
+        // front-facing flags for this instance, one per face of the mesh
+        vector<unsigned char> frontFaces;
+};
+
+/*  ============== scene ==============
+        Purpose: Container for several meshes and their instances
+
+        Each mesh is loaded once (by path) and is drawn for every instance
+        that refers to it by replaying its display list, so the vertex data
+        is sent to GL once no matter how many copies are on screen.
+        Front faces and silhouettes are computed per instance in the mesh's
+        object space, so no vertex is ever transformed on the CPU.
+
+        Example usage:
+        1.) scene* myScene = new scene();
+        2.) int cow = myScene->addMesh("./data/cow.ply");
+        3.) myScene->addInstance(cow, glm::translate(glm::mat4(1.0f), offset), color);
+        4.) myScene->render(true);
+            myScene->renderSilhouette(eyePosition);
+        5.) delete myScene;
+        ==================================== */
+class scene {
+public:
+        scene();
+        ~scene();
+
+        /*      ===============================================
+                Desc: Loads a mesh, or returns the index of the mesh
+                already loaded from the same path
+        =============================================== */
+        int addMesh(string filePath);
+        int addInstance(int mesh, glm::mat4 transform, glm::vec3 color);
+        /*      ===============================================
+                Desc: Lays out rows x cols instances of mesh on a grid
+                that fits in the unit cube, with varying colours
+        =============================================== */
+        void addGrid(int mesh, int rows, int cols);
+        void clear();
+
+        int getMeshCount() { return (int)meshes.size(); }
+        int getInstanceCount() { return (int)instances.size(); }
+
+        /*      ===============================================
+                Desc: Draws every instance filled, in its own colour
+                when useColor is set (otherwise in the current colour,
+                e.g. for the wireframe pass)
+        =============================================== */
+        void render(bool useColor);
+        /*      ===============================================
+                Desc: Draws the silhouette of every instance
+                eyePosition is the camera position in the space the
+                instances are placed in (i.e. before the view rotation)
+        =============================================== */
+        void renderSilhouette(glm::vec3 eyePosition);
+
+private:
+        vector<ply*> meshes;
+        vector<string> meshPaths;
+        vector<instance> instances;
+};
+
+#endif
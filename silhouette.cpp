@@ -0,0 +1,425 @@
+/*  =================== File Information =================
+  File Name: silhouette.cpp
+  Description: Tracks the silhouette edge set from frame to frame
+  ===================================================== */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "silhouette.h"
+#include "parallel.h"
+
+using namespace std;
+
+silhouetteTracker::silhouetteTracker() {
+	jumpAngle = 20.0f;
+	gridResolution = 16;
+	lastFacesTested = 0;
+	lastEdgesTested = 0;
+	fullRecomputes = 0;
+	mesh = NULL;
+	frame = 0;
+	haveLast = false;
+}
+
+/*  ===============================================
+	  Desc: Cube-map bucket of a unit normal: the dominant axis and sign
+	  pick one of six cube faces, the other two components pick a cell
+	  on a resolution x resolution grid on it. -1 for a NaN normal
+	  (degenerate face), which can never be front facing.
+	=============================================== */
+static int normalBucket(glm::vec3 n, int resolution) {
+	if (n.x != n.x || n.y != n.y || n.z != n.z) {
+		return -1;
+	}
+	glm::vec3 a = glm::abs(n);
+	int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+	if (a[axis] == 0.0f) {
+		return -1;
+	}
+	int side = n[axis] < 0 ? 1 : 0;
+	float u = n[(axis + 1) % 3] / a[axis];
+	float v = n[(axis + 2) % 3] / a[axis];
+	int i = min(resolution - 1, max(0, (int)((u + 1.0f) * 0.5f * resolution)));
+	int j = min(resolution - 1, max(0, (int)((v + 1.0f) * 0.5f * resolution)));
+	return ((axis * 2 + side) * resolution + i) * resolution + j;
+}
+
+void silhouetteTracker::setMesh(ply* _mesh) {
+	mesh = _mesh;
+	haveLast = false;
+	current.clear();
+	previous.clear();
+
+	int faceCount = mesh->getFaceCount();
+	int edgeCount = mesh->getEdgeCount();
+
+	faceEdges.assign(3 * (size_t)faceCount, -1);
+	for (int i = 0; i < edgeCount; i++) {
+		for (int side = 0; side < 2; side++) {
+			int* slots = &faceEdges[3 * (size_t)mesh->getEdge(i)->faces[side]];
+			for (int k = 0; k < 3; k++) {
+				if (slots[k] < 0) {
+					slots[k] = i;
+					break;
+				}
+			}
+		}
+	}
+
+	// faces per bucket (count, prefix sum, fill)
+	int bucketCount = 6 * gridResolution * gridResolution;
+	vector<int> faceBucket(faceCount);
+	bucketOffsets.assign(bucketCount + 1, 0);
+	for (int i = 0; i < faceCount; i++) {
+		faceBucket[i] = normalBucket(mesh->getFace(i)->faceNormal, gridResolution);
+		if (faceBucket[i] >= 0) {
+			bucketOffsets[faceBucket[i] + 1]++;
+		}
+	}
+	for (int b = 0; b < bucketCount; b++) {
+		bucketOffsets[b + 1] += bucketOffsets[b];
+	}
+	bucketFaces.resize(bucketOffsets[bucketCount]);
+	vector<int> fill(bucketOffsets.begin(), bucketOffsets.end() - 1);
+	for (int i = 0; i < faceCount; i++) {
+		if (faceBucket[i] >= 0) {
+			bucketFaces[fill[faceBucket[i]]++] = i;
+		}
+	}
+
+	bucketCenters.assign(bucketCount, glm::vec3(0.0f, 0.0f, 0.0f));
+	bucketRadii.assign(bucketCount, 0.0f);
+	for (int b = 0; b < bucketCount; b++) {
+		if (bucketOffsets[b] == bucketOffsets[b + 1]) {
+			continue;
+		}
+		glm::vec3 sum(0.0f, 0.0f, 0.0f);
+		for (int k = bucketOffsets[b]; k < bucketOffsets[b + 1]; k++) {
+			sum += mesh->getFace(bucketFaces[k])->faceNormal;
+		}
+		// a cube-map cell spans well under 90 degrees, so the sum is never 0
+		bucketCenters[b] = glm::normalize(sum);
+		for (int k = bucketOffsets[b]; k < bucketOffsets[b + 1]; k++) {
+			float distance = glm::length(mesh->getFace(bucketFaces[k])->faceNormal - bucketCenters[b]);
+			bucketRadii[b] = max(bucketRadii[b], distance);
+		}
+	}
+
+	faceFront.assign(faceCount, 0);
+	edgeStamp.assign(edgeCount, 0);
+	frame = 0;
+}
+
+// facing of a face for the current look vector
+bool silhouetteTracker::facing(int faceIndex) {
+	return glm::dot(look, mesh->getFace(faceIndex)->faceNormal) < 0;
+}
+
+// adds the edge to the silhouette if it is one, once per frame
+void silhouetteTracker::testEdge(int edgeIndex) {
+	if (edgeStamp[edgeIndex] == frame) {
+		return;
+	}
+	edgeStamp[edgeIndex] = frame;
+	lastEdgesTested++;
+
+	edge* e = mesh->getEdge(edgeIndex);
+	if (facing(e->faces[0]) != facing(e->faces[1])) {
+		current.push_back(edgeIndex);
+	}
+}
+
+const vector<int>& silhouetteTracker::update(glm::vec3 lookVector) {
+	if (mesh == NULL) {
+		current.clear();
+		return current;
+	}
+
+	look = glm::normalize(lookVector);
+	frame++;
+	if (frame == 0) {
+		// the stamps wrapped around, so old stamps could look current
+		fill(edgeStamp.begin(), edgeStamp.end(), 0);
+		frame = 1;
+	}
+
+	float cosJump = cos(glm::radians(jumpAngle));
+	if (!haveLast || glm::dot(look, lastLook) < cosJump) {
+		fullUpdate();
+	}
+	else {
+		incrementalUpdate(glm::length(look - lastLook));
+	}
+
+	lastLook = look;
+	haveLast = true;
+	return current;
+}
+
+void silhouetteTracker::fullUpdate() {
+	int faceCount = mesh->getFaceCount();
+	for (int i = 0; i < faceCount; i++) {
+		faceFront[i] = facing(i);
+	}
+	computeAll(look, current);
+	lastFacesTested = faceCount;
+	lastEdgesTested = mesh->getEdgeCount();
+	fullRecomputes++;
+}
+
+/*  ===============================================
+	  Desc: Visits the faces whose normal is within bandWidth of the plane
+	  perpendicular to lastLook (the only ones that can have flipped),
+	  then re-tests the edges of flipped faces and the old silhouette
+	=============================================== */
+void silhouetteTracker::incrementalUpdate(float bandWidth) {
+	previous.swap(current);
+	current.clear();
+	lastFacesTested = 0;
+	lastEdgesTested = 0;
+
+	int bucketCount = (int)bucketCenters.size();
+	for (int b = 0; b < bucketCount; b++) {
+		// |n.lastLook| >= |c.lastLook| - |n - c| for every normal n in the bucket
+		if (fabs(glm::dot(bucketCenters[b], lastLook)) - bucketRadii[b] > bandWidth) {
+			continue;
+		}
+		for (int k = bucketOffsets[b]; k < bucketOffsets[b + 1]; k++) {
+			int faceIndex = bucketFaces[k];
+			lastFacesTested++;
+			unsigned char front = facing(faceIndex);
+			if (front == faceFront[faceIndex]) {
+				continue;
+			}
+			faceFront[faceIndex] = front;
+			for (int s = 0; s < 3; s++) {
+				if (faceEdges[3 * (size_t)faceIndex + s] >= 0) {
+					testEdge(faceEdges[3 * (size_t)faceIndex + s]);
+				}
+			}
+		}
+	}
+
+	// old silhouette edges whose faces did not flip are still on it,
+	// testing them is as cheap as checking that
+	for (size_t i = 0; i < previous.size(); i++) {
+		testEdge(previous[i]);
+	}
+}
+
+void silhouetteTracker::computeAll(glm::vec3 lookVector, vector<int>& edges) {
+	edges.clear();
+	int edgeCount = mesh->getEdgeCount();
+	for (int i = 0; i < edgeCount; i++) {
+		edge* e = mesh->getEdge(i);
+		bool front0 = glm::dot(lookVector, mesh->getFace(e->faces[0])->faceNormal) < 0;
+		bool front1 = glm::dot(lookVector, mesh->getFace(e->faces[1])->faceNormal) < 0;
+		if (front0 != front1) {
+			edges.push_back(i);
+		}
+	}
+}
+
+int silhouetteTracker::countMissing(glm::vec3 lookVector) {
+	vector<int> expected;
+	computeAll(lookVector, expected);
+
+	vector<char> found(mesh->getEdgeCount(), 0);
+	for (size_t i = 0; i < current.size(); i++) {
+		found[current[i]] = 1;
+	}
+	int missing = 0;
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (!found[expected[i]]) {
+			missing++;
+		}
+	}
+	return missing;
+}
+
+
+silhouetteCache::silhouetteCache() {
+	sampleCount = 1024;
+	cellResolution = 64;
+	exact = true;
+	bandAngle = 0.0f;
+	candidateCount = 0;
+	buildSeconds = 0.0;
+	lastEdgesTested = 0;
+	cancel = false;
+	mesh = NULL;
+	builtResolution = 1;
+}
+
+void silhouetteCache::clear() {
+	mesh = NULL;
+	samples.clear();
+	cellSample.clear();
+	sampleOffsets.clear();
+	sampleEdges.clear();
+	silhouetteSizes.clear();
+	current.clear();
+	bandAngle = 0.0f;
+	candidateCount = 0;
+}
+
+// the direction through point (u, v) of a cube-map face, as laid out
+// by normalBucket (u and v run from -1 to 1)
+static glm::vec3 cellDirection(int axis, int side, float u, float v) {
+	glm::vec3 direction;
+	direction[axis] = side ? -1.0f : 1.0f;
+	direction[(axis + 1) % 3] = u;
+	direction[(axis + 2) % 3] = v;
+	return glm::normalize(direction);
+}
+
+static float angleBetween(glm::vec3 a, glm::vec3 b) {
+	return acos(glm::clamp(glm::dot(a, b), -1.0f, 1.0f));
+}
+
+/*  ===============================================
+	  Desc: bandAngle is the largest, over all cells, of the angle from
+	  the cell's centre to its sample plus the angle from the centre to
+	  the cell's farthest corner. A face can only change facing between
+	  a sample s and a look vector L with |s - L| <= chord if
+	  |n.s| <= chord, which picks the candidates.
+	=============================================== */
+void silhouetteCache::build(ply* _mesh) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	clear();
+	mesh = _mesh;
+
+	int count = max(1, sampleCount);
+	const float goldenAngle = 2.39996323f;
+	samples.resize(count);
+	for (int k = 0; k < count; k++) {
+		float y = 1.0f - 2.0f * (k + 0.5f) / count;
+		float radius = sqrt(fmax(0.0f, 1.0f - y * y));
+		samples[k] = glm::vec3(radius * cos(goldenAngle * k), y, radius * sin(goldenAngle * k));
+	}
+
+	int resolution = max(1, cellResolution);
+	builtResolution = resolution;
+	int cellCount = 6 * resolution * resolution;
+	cellSample.resize(cellCount);
+	vector<float> cellReach(cellCount);
+	parallelFor(0, cellCount, 64, [&](int begin, int end) {
+		for (int cell = begin; cell < end; cell++) {
+			int j = cell % resolution;
+			int i = cell / resolution % resolution;
+			int axis = cell / (resolution * resolution) / 2;
+			int side = cell / (resolution * resolution) % 2;
+			float u0 = 2.0f * i / resolution - 1.0f, u1 = 2.0f * (i + 1) / resolution - 1.0f;
+			float v0 = 2.0f * j / resolution - 1.0f, v1 = 2.0f * (j + 1) / resolution - 1.0f;
+			glm::vec3 center = cellDirection(axis, side, (u0 + u1) * 0.5f, (v0 + v1) * 0.5f);
+
+			int nearest = 0;
+			for (int k = 1; k < count; k++) {
+				if (glm::dot(samples[k], center) > glm::dot(samples[nearest], center)) {
+					nearest = k;
+				}
+			}
+			float corner = max(max(angleBetween(center, cellDirection(axis, side, u0, v0)),
+				angleBetween(center, cellDirection(axis, side, u0, v1))),
+				max(angleBetween(center, cellDirection(axis, side, u1, v0)),
+				angleBetween(center, cellDirection(axis, side, u1, v1))));
+			cellSample[cell] = nearest;
+			cellReach[cell] = angleBetween(center, samples[nearest]) + corner;
+		}
+	});
+	float band = *max_element(cellReach.begin(), cellReach.end());
+	bandAngle = glm::degrees(band);
+	// a little extra so rounding in the dot products cannot drop a face
+	float chord = 2.0f * sin(min(band, 3.14159265f) * 0.5f) + 1e-4f;
+
+	int faceCount = mesh->getFaceCount();
+	int edgeCount = mesh->getEdgeCount();
+	vector<vector<int> > lists(count);
+	vector<int> sizes(count);
+	parallelFor(0, count, 1, [&](int begin, int end) {
+		// bit 0: front facing at the sample, bit 1: in the band
+		vector<unsigned char> faceState(faceCount);
+		for (int k = begin; k < end && !cancel; k++) {
+			glm::vec3 sample = samples[k];
+			for (int i = 0; i < faceCount; i++) {
+				float d = glm::dot(sample, mesh->getFace(i)->faceNormal);
+				faceState[i] = (d < 0 ? 1 : 0) | (fabs(d) <= chord ? 2 : 0);
+			}
+			vector<int>& list = lists[k];
+			for (int i = 0; i < edgeCount; i++) {
+				edge* e = mesh->getEdge(i);
+				if ((faceState[e->faces[0]] ^ faceState[e->faces[1]]) & 1) {
+					list.push_back(i);
+				}
+			}
+			sizes[k] = (int)list.size();
+			for (int i = 0; i < edgeCount; i++) {
+				edge* e = mesh->getEdge(i);
+				unsigned char a = faceState[e->faces[0]], b = faceState[e->faces[1]];
+				if (!((a ^ b) & 1) && ((a | b) & 2)) {
+					list.push_back(i);
+				}
+			}
+		}
+	});
+	if (cancel) {
+		clear();
+		return;
+	}
+
+	sampleOffsets.assign(count + 1, 0);
+	for (int k = 0; k < count; k++) {
+		sampleOffsets[k + 1] = sampleOffsets[k] + lists[k].size();
+	}
+	candidateCount = sampleOffsets[count];
+	sampleEdges.resize(candidateCount);
+	parallelFor(0, count, 16, [&](int begin, int end) {
+		for (int k = begin; k < end; k++) {
+			copy(lists[k].begin(), lists[k].end(), sampleEdges.begin() + sampleOffsets[k]);
+			vector<int>().swap(lists[k]);
+		}
+	});
+	silhouetteSizes.swap(sizes);
+	buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+const vector<int>& silhouetteCache::update(glm::vec3 lookVector) {
+	current.clear();
+	lastEdgesTested = 0;
+	if (mesh == NULL || samples.empty()) {
+		return current;
+	}
+
+	glm::vec3 look = glm::normalize(lookVector);
+	int cell = normalBucket(look, builtResolution);
+	if (cell < 0) {
+		return current;
+	}
+	int k = cellSample[cell];
+	const int* first = sampleEdges.data() + sampleOffsets[k];
+	const int* last = sampleEdges.data() + sampleOffsets[k + 1];
+	if (!exact) {
+		current.assign(first, first + silhouetteSizes[k]);
+		return current;
+	}
+
+	for (const int* it = first; it != last; ++it) {
+		edge* e = mesh->getEdge(*it);
+		bool front0 = glm::dot(look, mesh->getFace(e->faces[0])->faceNormal) < 0;
+		bool front1 = glm::dot(look, mesh->getFace(e->faces[1])->faceNormal) < 0;
+		if (front0 != front1) {
+			current.push_back(*it);
+		}
+	}
+	lastEdgesTested = (int)(last - first);
+	return current;
+}
+
+size_t silhouetteCache::getMemoryBytes() {
+	return samples.capacity() * sizeof(glm::vec3)
+		+ cellSample.capacity() * sizeof(int)
+		+ sampleOffsets.capacity() * sizeof(size_t)
+		+ sampleEdges.capacity() * sizeof(int)
+		+ silhouetteSizes.capacity() * sizeof(int)
+		+ current.capacity() * sizeof(int);
+}
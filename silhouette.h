@@ -0,0 +1,193 @@
+/*  =================== File Information =================
+        File Name: silhouette.h
+        Description: Incremental silhouette tracking between frames
+
+        Purpose:        Find the silhouette edges for a new view from the
+                        previous frame's silhouette and the few faces that
+                        can have changed facing, instead of testing every
+                        edge of the mesh again
+        Examples:       See example below for using silhouetteTracker
+        ===================================================== */
+#ifndef SILHOUETTE_H
+#define SILHOUETTE_H
+
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== silhouetteTracker ==============
+        Purpose: Keeps the silhouette edge set of one mesh up to date as
+        the look vector changes a little every frame.
+
+        An edge only enters or leaves the silhouette when one of its faces
+        flips between front and back facing. Going from look vector L0 to
+        L1, a face with unit normal n can only flip if |n.L0| <= |L1 - L0|,
+        i.e. if its normal lies in a thin band around the great circle
+        perpendicular to L0. Faces are bucketed by normal direction (a cube
+        map of normals), so each update only visits the buckets that reach
+        into that band, tests their faces against the facing stored last
+        frame, and re-tests the edges of faces that flipped plus the
+        previous frame's silhouette edges. Every other edge keeps its state.
+
+        The result is exact, not an approximation: every edge reported is
+        tested, and every face that can have flipped is visited. Views that
+        jump by more than jumpAngle degrees are recomputed over every edge.
+
+        Example usage:
+        1.) silhouetteTracker* tracker = new silhouetteTracker();
+        2.) tracker->setMesh(myPLY);             // after every (re)load
+        3.) myPLY->renderSilhouetteEdges(tracker->update(lookVector));
+        4.) delete tracker;
+        ==================================== */
+class silhouetteTracker {
+public:
+        silhouetteTracker();
+
+        /*      ===============================================
+                Desc: Buckets the faces of mesh by normal and forgets the
+                previous silhouette
+        =============================================== */
+        void setMesh(ply* _mesh);
+
+        /*      ===============================================
+                Desc: Returns the silhouette edges (indices into the
+                mesh's edge list) for lookVector
+        =============================================== */
+        const vector<int>& update(glm::vec3 lookVector);
+
+        /*      ===============================================
+                Desc: Brute-force silhouette for lookVector, and the number
+                of brute-force edges missing from the tracked set
+                (0 means the last update was exact)
+        =============================================== */
+        void computeAll(glm::vec3 lookVector, vector<int>& edges);
+        int countMissing(glm::vec3 lookVector);
+
+        // tuning (gridResolution takes effect in setMesh)
+        float jumpAngle;
+        int gridResolution;
+
+        // how many faces and edges the last update tested, and how many
+        // full passes so far
+        int lastFacesTested;
+        int lastEdgesTested;
+        int fullRecomputes;
+
+private:
+        bool facing(int faceIndex);
+        void testEdge(int edgeIndex);
+        void fullUpdate();
+        void incrementalUpdate(float bandWidth);
+
+        ply* mesh;
+        // the (up to three) shared edges of each face, -1 where there is none
+        vector<int> faceEdges;
+
+        // faces of each normal bucket: bucketFaces[bucketOffsets[b] .. bucketOffsets[b + 1])
+        vector<int> bucketOffsets;
+        vector<int> bucketFaces;
+        // mean normal of each bucket and the largest distance from it to
+        // a normal in the bucket
+        vector<glm::vec3> bucketCenters;
+        vector<float> bucketRadii;
+
+        // facing of every face for lastLook
+        vector<unsigned char> faceFront;
+        // edges already tested this frame have stamp == frame
+        vector<unsigned int> edgeStamp;
+        unsigned int frame;
+
+        glm::vec3 look;
+        glm::vec3 lastLook;
+        bool haveLast;
+        vector<int> current;
+        vector<int> previous;
+};
+
+/*  ============== silhouetteCache ==============
+        Purpose: Precomputed silhouette candidates for a sphere of view
+        directions, for viewing that keeps orbiting the same model and
+        so keeps coming back to the same directions.
+
+        sampleCount look directions are spread evenly over the sphere
+        (Fibonacci points). A cube map of directions stores the nearest
+        sample of each of its cells, so any look vector finds its sample
+        in O(1), and that sample is never more than bandAngle away.
+        For each sample the cache keeps the sample's own silhouette
+        followed by every other edge with a face whose normal is within
+        bandAngle of perpendicular to the sample; no other edge can
+        change between the sample and a look vector that snaps to it
+        (the same band argument as silhouetteTracker). update() tests
+        only those candidates, so it is exact and costs about the same
+        every frame. With exact off it returns the sample's silhouette
+        as it is, without testing anything.
+
+        More samples give a narrower band and fewer candidates per
+        sample but more lists to store; getMemoryBytes() and the
+        candidate counts show where a mesh ends up.
+
+        build() can take seconds on a large mesh, so it is meant to run
+        on a thread of its own; setting cancel from another thread stops
+        it early and leaves the cache empty.
+
+        Example usage:
+        1.) silhouetteCache* cache = new silhouetteCache();
+        2.) cache->sampleCount = 2048;
+            cache->build(myPLY);              // after every (re)load
+        3.) myPLY->renderSilhouetteEdges(cache->update(lookVector));
+        4.) delete cache;
+        ==================================== */
+class silhouetteCache {
+public:
+        silhouetteCache();
+
+        /*      ===============================================
+                Desc: Samples the directions and collects the candidate
+                edges of every sample, in parallel on the worker pool
+        =============================================== */
+        void build(ply* _mesh);
+        void clear();
+        // the mesh the cache was built for (NULL if none)
+        ply* getMesh() { return mesh; }
+
+        /*      ===============================================
+                Desc: Returns the silhouette edges (indices into the
+                mesh's edge list) for lookVector
+        =============================================== */
+        const vector<int>& update(glm::vec3 lookVector);
+
+        size_t getMemoryBytes();
+
+        // tuning (sampleCount and cellResolution take effect in build)
+        int sampleCount;
+        int cellResolution;
+        bool exact;
+
+        // angle (degrees) from any look vector to its sample, the
+        // candidates stored over all samples, how long build took, and
+        // how many edges the last update tested
+        float bandAngle;
+        size_t candidateCount;
+        double buildSeconds;
+        int lastEdgesTested;
+        atomic<bool> cancel;
+
+private:
+        ply* mesh;
+        vector<glm::vec3> samples;
+        // nearest sample of every cube-map cell, at the resolution
+        // of the last build
+        vector<int> cellSample;
+        int builtResolution;
+        // edges of sample k: sampleEdges[sampleOffsets[k] .. sampleOffsets[k + 1]),
+        // its own silhouette (silhouetteSizes[k] edges) first
+        vector<size_t> sampleOffsets;
+        vector<int> sampleEdges;
+        vector<int> silhouetteSizes;
+        vector<int> current;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*  =================== File Information =================
+    File Name: silhouettetest.cpp
+    Description: Checks the silhouette tracker and cache against brute force
+
+    Purpose: Run by "make check". For every .ply file given, walks the
+             look vector through random view directions, mostly small
+             steps (the incremental path) with a jump past jumpAngle
+             now and then (the full pass), and compares every
+             silhouetteTracker::update with silhouetteTracker::computeAll
+             edge for edge. silhouetteCache::update is compared the same
+             way over random directions. Exits with 1 if any frame
+             differs.
+    Usage:   silhouettetest [-n views] [-s seed] <file>...
+             -n  view directions per mesh and check (default 2000)
+             -s  seed of the random directions (default 1)
+    ===================================================== */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ply.h"
+#include "silhouette.h"
+
+using namespace std;
+
+static void usage() {
+    cout << "usage: silhouettetest [-n views] [-s seed] <file>..." << endl;
+}
+
+// uniform over the sphere
+static glm::vec3 randomDirection(mt19937 &random) {
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    while (true) {
+        glm::vec3 v(unit(random), unit(random), unit(random));
+        float     length = glm::length(v);
+        if (length > 1e-3f && length <= 1.0f) {
+            return v / length;
+        }
+    }
+}
+
+// the tracked silhouette along a random walk; returns the frames that differ
+static int checkTracker(ply &mesh, int views, mt19937 &random) {
+    silhouetteTracker tracker;
+    tracker.setMesh(&mesh);
+    silhouetteTracker brute;
+    brute.setMesh(&mesh);
+
+    uniform_real_distribution<float> fraction(0.0f, 1.0f);
+    glm::vec3   look = randomDirection(random);
+    vector<int> found, expected;
+    int         badFrames = 0;
+    for (int i = 0; i < views; i++) {
+        if (fraction(random) < 0.05f) {
+            look = randomDirection(random);
+        }
+        else {
+            // a step of up to 1.5 jumpAngle, so both paths are taken
+            float step = glm::radians(tracker.jumpAngle) * 1.5f * fraction(random);
+            look       = glm::normalize(look + randomDirection(random) * step);
+        }
+
+        found = tracker.update(look);
+        // update normalizes again; the brute force gets the same vector,
+        // or rounding can flip a face seen exactly edge on
+        brute.computeAll(glm::normalize(look), expected);
+        sort(found.begin(), found.end());
+        if (found != expected) {
+            badFrames++;
+        }
+    }
+    return badFrames;
+}
+
+// the cached silhouette for random directions; returns the frames that differ
+static int checkCache(ply &mesh, int views, mt19937 &random) {
+    silhouetteCache cache;
+    cache.build(&mesh);
+    silhouetteTracker brute;
+    brute.setMesh(&mesh);
+
+    vector<int> found, expected;
+    int         badFrames = 0;
+    for (int i = 0; i < views; i++) {
+        glm::vec3 look = randomDirection(random);
+        found          = cache.update(look);
+        brute.computeAll(glm::normalize(look), expected);
+        sort(found.begin(), found.end());
+        if (found != expected) {
+            badFrames++;
+        }
+    }
+    return badFrames;
+}
+
+
+/**************************************** main() ********************/
+int main(int argc, char **argv) {
+    int            views = 2000;
+    unsigned int   seed  = 1;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            views = atoi(argv[++i]);
+        }
+        else if (arg == "-s" && i + 1 < argc) {
+            seed = (unsigned int)atoi(argv[++i]);
+        }
+        else if (arg[0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        usage();
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+        ply mesh;
+        if (!mesh.reload(files[f])) {
+            failed++;
+            continue;
+        }
+
+        mt19937 random(seed);
+        int     trackerBad = checkTracker(mesh, views, random);
+        int     cacheBad   = checkCache(mesh, views, random);
+        bool    ok         = trackerBad == 0 && cacheBad == 0;
+        cout << (ok ? "ok   " : "FAIL ") << files[f] << ": tracker " << trackerBad << " of " << views
+             << " views differ, cache " << cacheBad << " of " << views << " views differ" << endl;
+        if (!ok) {
+            failed++;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,275 @@
+/*  =================== File Information =================
+  File Name: svgexport.cpp
+  Description: Projects silhouettes with the canvas camera and writes SVG
+  ===================================================== */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include "svgexport.h"
+#include "parallel.h"
+
+using namespace std;
+
+// a segment is hidden if the mesh is hit before this fraction of the way
+// from the eye to its midpoint; the faces at the segment itself are hit
+// at 1 and must not count
+static const float HIDDEN_OFFSET = 1e-3f;
+
+silhouetteExporter::silhouetteExporter() {
+	width = 800;
+	height = 800;
+	strokeWidth = 1.5f;
+	hiddenLines = false;
+	lastSeconds = 0.0;
+	lastSegments = 0;
+}
+
+static string viewPath(const string& prefix, int index) {
+	char number[16];
+	snprintf(number, sizeof(number), "_%04d.svg", index);
+	return prefix + number;
+}
+
+// value with two decimals; printf's float formatting was most of the
+// time spent per view
+static void appendFixed(string& out, float value) {
+	long hundredths = lround(value * 100.0f);
+	if (hundredths < 0) {
+		out += '-';
+		hundredths = -hundredths;
+	}
+	char digits[24];
+	int length = 0;
+	do {
+		digits[length++] = (char)('0' + hundredths % 10);
+		hundredths /= 10;
+		if (length == 2) {
+			digits[length++] = '.';
+		}
+	} while (hundredths > 0 || length < 4);
+	while (length > 0) {
+		out += digits[--length];
+	}
+}
+
+// "x,y" in pixels, after a space unless it is the first point
+static void appendPoint(string& out, const glm::vec3& point, bool separate) {
+	if (separate) {
+		out += ' ';
+	}
+	appendFixed(out, point.x);
+	out += ',';
+	appendFixed(out, point.y);
+}
+
+void silhouetteExporter::turntableViews(int count, float tilt, string prefix, vector<svgView>& views) {
+	views.clear();
+	for (int i = 0; i < count; i++) {
+		svgView view = { tilt, 360.0f * i / count, 0.0f, viewPath(prefix, i) };
+		views.push_back(view);
+	}
+}
+
+/*  ===============================================
+	  Desc: Point i of count on the Fibonacci sphere is the direction
+	  from the model to the eye. With the canvas rotations that
+	  direction is (-cos(rotX) sin(rotY), sin(rotX), cos(rotX) cos(rotY)),
+	  which gives rotX and rotY directly.
+	=============================================== */
+void silhouetteExporter::sphereViews(int count, string prefix, vector<svgView>& views) {
+	views.clear();
+	const float goldenAngle = 2.39996323f;
+	for (int i = 0; i < count; i++) {
+		float y = 1.0f - 2.0f * (i + 0.5f) / count;
+		float radius = sqrt(fmax(0.0f, 1.0f - y * y));
+		float angle = goldenAngle * i;
+		glm::vec3 direction(radius * cos(angle), y, radius * sin(angle));
+		svgView view = { glm::degrees(asin(direction.y)), glm::degrees(atan2(-direction.x, direction.z)),
+			0.0f, viewPath(prefix, i) };
+		views.push_back(view);
+	}
+}
+
+int silhouetteExporter::exportViews(ply* mesh, const vector<svgView>& views) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// the mesh's own BVH, unless the memory budget left it out
+	bvh localTree;
+	bvh* tree = NULL;
+	if (!hiddenLines) {
+		tree = mesh->getBVH();
+		if (tree->getNodeCount() == 0) {
+			localTree.build(mesh);
+			tree = &localTree;
+		}
+	}
+
+	atomic<int> written(0);
+	atomic<long> segments(0);
+	parallelFor(0, (int)views.size(), 1, [&](int begin, int end) {
+		scratch buffers;
+		for (int i = begin; i < end; i++) {
+			ofstream out(views[i].path.c_str());
+			if (!out.is_open()) {
+				cout << "cannot write file " << views[i].path << "\n";
+				continue;
+			}
+			segments += writeView(mesh, tree, views[i], buffers, out);
+			if (out.good()) {
+				written++;
+			}
+		}
+	});
+
+	lastSegments = segments;
+	lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return written;
+}
+
+void silhouetteExporter::writeView(ply* mesh, const svgView& view, ostream& out) {
+	bvh localTree;
+	bvh* tree = NULL;
+	if (!hiddenLines) {
+		tree = mesh->getBVH();
+		if (tree->getNodeCount() == 0) {
+			localTree.build(mesh);
+			tree = &localTree;
+		}
+	}
+	scratch buffers;
+	writeView(mesh, tree, view, buffers, out);
+}
+
+/*  ===============================================
+	  Desc: Writes one view and returns the number of segments drawn
+	  The camera is MyGLCanvas::updateCamera's and the model rotation
+	  is draw()'s; the eye is taken back into object space the same way
+	  draw() does.
+	  Loops that are fully visible become <polygon>s, everything else
+	  <polyline>s, one per visible run.
+	=============================================== */
+long silhouetteExporter::writeView(ply* mesh, bvh* tree, const svgView& view, scratch& buffers, ostream& out) {
+	glm::vec3 eyePosition(0.0f, 0.0f, 2.0f);
+	glm::mat4 model = glm::rotate(glm::mat4(1.0), glm::radians(view.rotX), glm::vec3(1.0f, 0.0f, 0.0f));
+	model = glm::rotate(model, glm::radians(view.rotY), glm::vec3(0.0f, 1.0f, 0.0f));
+	model = glm::rotate(model, glm::radians(view.rotZ), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 transform = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 10.0f)
+		* glm::lookAt(eyePosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * model;
+
+	glm::mat4 rotXMat = glm::rotate(glm::mat4(1.0), glm::radians(-view.rotX), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotYMat = glm::rotate(glm::mat4(1.0), glm::radians(-view.rotY), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotZMat = glm::rotate(glm::mat4(1.0), glm::radians(-view.rotZ), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 inverseRotation = rotZMat * rotYMat * rotXMat;
+	glm::vec3 eye = glm::vec3(inverseRotation * glm::vec4(eyePosition, 1.0f));
+
+	// facing is tested against the eye itself rather than the look
+	// vector, so the silhouette is the true perspective contour and
+	// the rays to it only graze the faces next to it
+	int faceCount = mesh->getFaceCount();
+	buffers.frontFaces.resize(faceCount);
+	for (int i = 0; i < faceCount; i++) {
+		face* f = mesh->getFace(i);
+		buffers.frontFaces[i] = glm::dot(mesh->getVertex(f->vertexList[0])->position - eye, f->faceNormal) < 0 ? 1 : 0;
+	}
+	mesh->getSilhouettePolylines(buffers.frontFaces, buffers.edges, buffers.polylines);
+
+	out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+	out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height
+		<< "\" viewBox=\"0 0 " << width << " " << height << "\">\n";
+	out << "<g fill=\"none\" stroke=\"black\" stroke-width=\"" << strokeWidth
+		<< "\" stroke-linejoin=\"round\" stroke-linecap=\"round\">\n";
+
+	long drawn = 0;
+	string points;
+	for (size_t p = 0; p < buffers.polylines.size(); p++) {
+		const polyline& line = buffers.polylines[p];
+		int count = (int)line.vertices.size();
+		int segmentCount = line.closed ? count : count - 1;
+		if (segmentCount < 1) {
+			continue;
+		}
+
+		buffers.screen.resize(count);
+		for (int i = 0; i < count; i++) {
+			glm::vec4 clip = transform * glm::vec4(mesh->getVertex(line.vertices[i])->position, 1.0f);
+			// SVG's y runs down
+			buffers.screen[i] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * width,
+				(0.5f - clip.y / clip.w * 0.5f) * height, 0.0f);
+		}
+
+		buffers.visible.assign(segmentCount, 1);
+		if (tree != NULL) {
+			rayPacket packet;
+			for (int first = 0; first < segmentCount; first += 4) {
+				int active = 0;
+				for (int k = 0; k < 4; k++) {
+					int s = min(first + k, segmentCount - 1);
+					glm::vec3 middle = (mesh->getVertex(line.vertices[s])->position
+						+ mesh->getVertex(line.vertices[(s + 1) % count])->position) * 0.5f;
+					glm::vec3 direction = middle - eye;
+					packet.originX[k] = eye.x;
+					packet.originY[k] = eye.y;
+					packet.originZ[k] = eye.z;
+					packet.directionX[k] = direction.x;
+					packet.directionY[k] = direction.y;
+					packet.directionZ[k] = direction.z;
+					packet.minT[k] = 0.0f;
+					packet.maxT[k] = 1.0f - HIDDEN_OFFSET;
+					if (first + k < segmentCount) {
+						active |= 1 << k;
+					}
+				}
+				int hits = tree->occluded(packet, active);
+				for (int k = 0; k < 4 && first + k < segmentCount; k++) {
+					buffers.visible[first + k] = !((hits >> k) & 1);
+				}
+			}
+		}
+
+		int hidden = -1;
+		for (int s = 0; s < segmentCount && hidden < 0; s++) {
+			if (!buffers.visible[s]) {
+				hidden = s;
+			}
+		}
+		if (line.closed && hidden < 0) {
+			points.clear();
+			for (int i = 0; i < count; i++) {
+				appendPoint(points, buffers.screen[i], i > 0);
+			}
+			out << "<polygon points=\"" << points << "\"/>\n";
+			drawn += segmentCount;
+			continue;
+		}
+
+		// a loop with a hidden part starts right after it, so no visible
+		// run is split where the loop happens to begin
+		int start = line.closed ? hidden + 1 : 0;
+		int run = 0;
+		for (int k = 0; k <= segmentCount; k++) {
+			int s = (start + k) % segmentCount;
+			if (k < segmentCount && buffers.visible[s]) {
+				if (run == 0) {
+					points.clear();
+					appendPoint(points, buffers.screen[s], false);
+				}
+				int next = (s + 1) % count;
+				appendPoint(points, buffers.screen[next], true);
+				run++;
+			}
+			else if (run > 0) {
+				out << "<polyline points=\"" << points << "\"/>\n";
+				drawn += run;
+				run = 0;
+			}
+		}
+	}
+
+	out << "</g>\n</svg>\n";
+	return drawn;
+}
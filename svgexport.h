@@ -0,0 +1,104 @@
+/*  =================== File Information =================
+        File Name: svgexport.h
+        Description: Headless silhouette export to SVG for many views
+
+        Purpose:        Turn the silhouette of a mesh into vector line art
+                        for technical illustrations: a turntable or a
+                        sphere of views, each written as its own .svg,
+                        without a window or a GL context
+        Examples:       See example below for using silhouetteExporter
+        ===================================================== */
+#ifndef SVGEXPORT_H
+#define SVGEXPORT_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ply.h"
+
+using namespace std;
+
+/*  ============== svgView ==============
+        Purpose: One view to export. The rotations are in degrees and
+        are applied like MyGLCanvas's rotX, rotY and rotZ sliders.
+        ==================================== */
+struct svgView {
+        float rotX;
+        float rotY;
+        float rotZ;
+        string path;
+};
+
+/*  ============== silhouetteExporter ==============
+        Purpose: Writes the silhouette of a mesh as seen from each view.
+
+        The silhouette is every edge between a face turned towards the
+        eye and one turned away, chained into polylines and projected
+        with the camera of MyGLCanvas::updateCamera: 45 degree
+        perspective, near 0.1, far 10, eye at (0, 0, 2) looking at the
+        origin. Facing is tested against the eye position rather than
+        the look vector renderSilhouette uses, which gives the true
+        contour of the perspective view. Unless hiddenLines is set,
+        segments hidden behind the mesh are cut out by casting a ray from
+        the eye to their midpoint through the face BVH.
+
+        Views are spread over the worker pool. They only read the mesh,
+        its edge list and its BVH, so one loaded mesh serves every
+        thread; each thread keeps its own facing flags and polylines.
+
+        Example usage:
+        1.) silhouetteExporter exporter;
+        2.) vector<svgView> views;
+            silhouetteExporter::turntableViews(36, 20.0f, "out/bunny", views);
+        3.) exporter.exportViews(myPLY, views);
+        ==================================== */
+class silhouetteExporter {
+public:
+        silhouetteExporter();
+
+        /*      ===============================================
+                Desc: Views named prefix_0000.svg, prefix_0001.svg, ...
+                turntableViews orbits the vertical axis in count equal
+                steps, tilted by tilt degrees. sphereViews spreads count
+                eye directions evenly over the sphere (Fibonacci points).
+        =============================================== */
+        static void turntableViews(int count, float tilt, string prefix, vector<svgView>& views);
+        static void sphereViews(int count, string prefix, vector<svgView>& views);
+
+        /*      ===============================================
+                Desc: Writes every view to its path, in parallel.
+                Returns the number of files written.
+        =============================================== */
+        int exportViews(ply* mesh, const vector<svgView>& views);
+
+        /*      ===============================================
+                Desc: Writes the SVG for one view to out, e.g. a
+                string stream for callers that keep it in memory
+        =============================================== */
+        void writeView(ply* mesh, const svgView& view, ostream& out);
+
+        // picture size in pixels, line width, and whether to keep the
+        // parts of the silhouette the mesh hides
+        int width;
+        int height;
+        float strokeWidth;
+        bool hiddenLines;
+
+        // what the last exportViews() did
+        double lastSeconds;
+        long lastSegments;
+
+private:
+        // per-thread buffers for writeView
+        struct scratch {
+                vector<unsigned char> frontFaces;
+                vector<int> edges;
+                vector<polyline> polylines;
+                vector<glm::vec3> screen;
+                vector<unsigned char> visible;
+        };
+        long writeView(ply* mesh, bvh* tree, const svgView& view, scratch& buffers, ostream& out);
+};
+
+#endif